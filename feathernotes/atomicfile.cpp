@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include "atomicfile.h"
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#endif
+
+namespace FeatherNotes {
+
+AtomicFile::AtomicFile (const QString &filePath, bool sync) :
+    filePath_ (filePath),
+    sync_ (sync)
+{}
+/*************************/
+bool AtomicFile::open()
+{
+#ifdef Q_OS_UNIX
+    /* as with QSaveFile, a symlink is followed, so that its target
+       is replaced and the link is kept (even if it's dangling) */
+    targetPath_ = filePath_;
+    QFileInfo info (filePath_);
+    if (info.isSymLink())
+    {
+        const QString target = info.exists() ? info.canonicalFilePath() : info.symLinkTarget();
+        if (!target.isEmpty())
+        {
+            targetPath_ = target;
+            info.setFile (targetPath_);
+        }
+    }
+    QTemporaryFile *tmp = new QTemporaryFile (info.absolutePath() + "/." + info.fileName() + ".XXXXXX");
+    file_.reset (tmp);
+    if (!tmp->open())
+        return false;
+    /* keep the permissions of an existing file (QTemporaryFile
+       makes the file readable only by the owner) */
+    if (info.exists())
+        tmp->setPermissions (info.permissions());
+    else
+        tmp->setPermissions (QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
+    return true;
+#else
+    /* QSaveFile always flushes the data on committing */
+    QSaveFile *saveFile = new QSaveFile (filePath_);
+    file_.reset (saveFile);
+    return saveFile->open (QIODevice::WriteOnly);
+#endif
+}
+/*************************/
+QIODevice *AtomicFile::device() const
+{
+    return file_.data();
+}
+/*************************/
+bool AtomicFile::commit()
+{
+    if (!file_) return false;
+#ifdef Q_OS_UNIX
+    QTemporaryFile *tmp = static_cast<QTemporaryFile*>(file_.data());
+    if (!tmp->isOpen() || !tmp->flush())
+        return false;
+    if (sync_ && ::fsync (tmp->handle()) != 0)
+        return false;
+    const QString tmpPath = tmp->fileName();
+    tmp->close();
+    /* unlike QFile::rename(), rename() replaces the target atomically */
+    if (::rename (QFile::encodeName (tmpPath).constData(),
+                  QFile::encodeName (targetPath_).constData()) != 0)
+    {
+        return false;
+    }
+    tmp->setAutoRemove (false);
+    if (sync_)
+    { // also make the new directory entry durable
+        int fd = ::open (QFile::encodeName (QFileInfo (targetPath_).absolutePath()).constData(), O_RDONLY);
+        if (fd != -1)
+        {
+            ::fsync (fd);
+            ::close (fd);
+        }
+    }
+    return true;
+#else
+    return static_cast<QSaveFile*>(file_.data())->commit();
+#endif
+}
+/*************************/
+bool AtomicFile::sync (const QString &filePath)
+{
+#ifdef Q_OS_UNIX
+    int fd = ::open (QFile::encodeName (filePath).constData(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    bool res = (::fsync (fd) == 0);
+    ::close (fd);
+    fd = ::open (QFile::encodeName (QFileInfo (filePath).absolutePath()).constData(), O_RDONLY);
+    if (fd != -1)
+    {
+        ::fsync (fd);
+        ::close (fd);
+    }
+    return res;
+#else
+    Q_UNUSED (filePath);
+    return true;
+#endif
+}
+
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+#include <QString>
+#include <QScopedPointer>
+#include <QIODevice>
+
+namespace FeatherNotes {
+
+// Like QSaveFile, writes into a temporary file beside the target and puts it in
+// place by renaming on committing, so that the target is never left truncated.
+// Unlike QSaveFile, it flushes the data to the disk only if that is requested
+// (on Unix), because syncing may be slow with network home directories.
+class AtomicFile
+{
+public:
+    /* an uncommitted file is discarded on destruction */
+    AtomicFile (const QString &filePath, bool sync);
+
+    bool open();
+    QIODevice *device() const;
+    /* renames the temporary file to the target */
+    bool commit();
+
+    /* flushes a file and the directory entry of its name to the disk */
+    static bool sync (const QString &filePath);
+
+private:
+    QString filePath_;
+    QString targetPath_; // the file that is replaced (a symlink is resolved)
+    bool sync_;
+    QScopedPointer<QIODevice> file_;
+};
+
+}
+
+#endif // ATOMICFILE_H
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decryptchain.h"
+#include <QtGlobal>
+#include <string.h>
+
+#ifdef SIMPLECRYPT_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef SIMPLECRYPT_AVX2
+#include <immintrin.h>
+#endif
+
+namespace FeatherNotes {
+
+char decryptChainScalar(char *data, int size, char lastChar, const char *key, int phase)
+{
+    for (int i = 0; i < size; ++i) {
+        const char c = data[i];
+        data[i] = c ^ lastChar ^ key[(phase + i) & 7];
+        lastChar = c;
+    }
+    return lastChar;
+}
+
+#ifdef SIMPLECRYPT_SSE2
+char decryptChainSse2(char *data, int size, char lastChar, const char *key, int phase)
+{
+    char pattern[16];
+    for (int j = 0; j < 16; ++j)
+        pattern[j] = key[(phase + j) & 7];
+    const __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern));
+    /* only the last byte of the previous block is used */
+    __m128i prev = _mm_slli_si128(_mm_cvtsi32_si128(static_cast<uchar>(lastChar)), 15);
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i *p = reinterpret_cast<__m128i*>(data + i);
+        const __m128i cur = _mm_loadu_si128(p);
+        /* the cyphertext shifted by one byte, without reading the overwritten data */
+        const __m128i shifted = _mm_or_si128(_mm_slli_si128(cur, 1), _mm_srli_si128(prev, 15));
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_xor_si128(cur, shifted), k));
+        prev = cur;
+    }
+    if (i > 0)
+        lastChar = static_cast<char>(_mm_cvtsi128_si32(_mm_srli_si128(prev, 15)) & 0xff);
+    return decryptChainScalar(data + i, size - i, lastChar, key, phase + i);
+}
+#endif
+
+#ifdef SIMPLECRYPT_AVX2
+__attribute__((target("avx2")))
+char decryptChainAvx2(char *data, int size, char lastChar, const char *key, int phase)
+{
+    char pattern[32];
+    for (int j = 0; j < 32; ++j)
+        pattern[j] = key[(phase + j) & 7];
+    const __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern));
+    char last[32];
+    memset(last, 0, sizeof(last));
+    last[31] = lastChar;
+    __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(last));
+    int i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i *p = reinterpret_cast<__m256i*>(data + i);
+        const __m256i cur = _mm256_loadu_si256(p);
+        /* the upper half of the previous block and the lower half of this one,
+           so that the bytes can be shifted across the 128-bit lanes */
+        const __m256i t = _mm256_permute2x128_si256(prev, cur, 0x21);
+        const __m256i shifted = _mm256_alignr_epi8(cur, t, 15);
+        _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_xor_si256(cur, shifted), k));
+        prev = cur;
+    }
+    if (i > 0)
+        lastChar = static_cast<char>(_mm256_extract_epi8(prev, 31));
+    return decryptChainScalar(data + i, size - i, lastChar, key, phase + i);
+}
+#endif
+
+#ifdef SIMPLECRYPT_AVX2
+bool cpuHasAvx2()
+{
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+}
+#endif
+
+char decryptChain(char *data, int size, char lastChar, const char *key, int phase)
+{
+#ifdef SIMPLECRYPT_AVX2
+    if (cpuHasAvx2())
+        return decryptChainAvx2(data, size, lastChar, key, phase);
+#endif
+#ifdef SIMPLECRYPT_SSE2
+    return decryptChainSse2(data, size, lastChar, key, phase);
+#else
+    return decryptChainScalar(data, size, lastChar, key, phase);
+#endif
+}
+
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DECRYPTCHAIN_H
+#define DECRYPTCHAIN_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMPLECRYPT_SSE2
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMPLECRYPT_AVX2 // compiled for AVX2 and chosen at runtime
+#endif
+
+namespace FeatherNotes {
+
+/*
+  The decryption of SimpleCrypt's version 3 is "p[i] = c[i] ^ c[i-1] ^ key[i % 8]",
+  i.e., it depends only on the cyphertext and so, unlike the encryption, can be
+  done for many bytes at once. The following functions decrypt in place and return
+  the last cyphertext byte, which is needed for the next block. "phase" is the
+  position of the first byte modulo 8.
+*/
+
+char decryptChainScalar(char *data, int size, char lastChar, const char *key, int phase);
+#ifdef SIMPLECRYPT_SSE2
+char decryptChainSse2(char *data, int size, char lastChar, const char *key, int phase);
+#endif
+#ifdef SIMPLECRYPT_AVX2
+bool cpuHasAvx2();
+char decryptChainAvx2(char *data, int size, char lastChar, const char *key, int phase);
+#endif
+
+/* uses the fastest kernel that the CPU supports */
+char decryptChain(char *data, int size, char lastChar, const char *key, int phase);
+
+}
+
+#endif // DECRYPTCHAIN_H
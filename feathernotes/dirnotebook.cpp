@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QDomElement>
+#include "dirnotebook.h"
+#include "atomicfile.h"
+#include "fnxreader.h"
+#include "fnxwriter.h"
+#include "dommodel.h"
+#include "domitem.h"
+
+namespace FeatherNotes {
+
+DirNotebook::DirNotebook (const QString &filePath) :
+    Notebook (filePath),
+    lastId_ (0)
+{}
+/*************************/
+// The directories are found by their names, so that they are found
+// even if the manifest isn't updated after moving them.
+void DirNotebook::scanDirs()
+{
+    QHash<qint64, QString> dirs;
+    lastId_ = 0;
+    QDirIterator it (nodesPath (filePath_), QDir::Dirs | QDir::NoDotAndDotDot,
+                     QDirIterator::Subdirectories);
+    while (it.hasNext())
+    {
+        const QString path = it.next();
+        bool ok;
+        const qint64 id = it.fileName().toLongLong (&ok);
+        if (!ok || id <= 0) continue;
+        dirs.insert (id, path);
+        lastId_ = qMax (lastId_, id);
+    }
+    QMutexLocker locker (&mutex_);
+    dirs_ = dirs;
+}
+/*************************/
+QString DirNotebook::dirOf (qint64 id) const
+{
+    QMutexLocker locker (&mutex_);
+    return dirs_.value (id);
+}
+/*************************/
+// Also updates the directories of descendants.
+void DirNotebook::moveDir (const QString &from, const QString &to)
+{
+    const QString prefix = from + "/";
+    QMutexLocker locker (&mutex_);
+    QHash<qint64, QString>::iterator it;
+    for (it = dirs_.begin(); it != dirs_.end(); ++it)
+    {
+        if (it.value() == from)
+            it.value() = to;
+        else if (it.value().startsWith (prefix))
+            it.value() = to + it.value().mid (from.length());
+    }
+}
+/*************************/
+static void takeIds (QDomElement parent, QVector<TextRange> &ranges, QVector<qint64> &order)
+{
+    QDomElement e = parent.firstChildElement ("node");
+    while (!e.isNull())
+    {
+        /* ids are kept by the notebook, not in the DOM tree */
+        bool ok;
+        const qint64 id = e.attribute ("id").toLongLong (&ok);
+        e.removeAttribute ("id");
+        TextRange range;
+        range.offset = ok && id > 0 ? id : -1;
+        range.length = ok && id > 0 ? 1 : 0;
+        ranges << range;
+        order << (ok ? id : 0);
+
+        takeIds (e, ranges, order);
+        e = e.nextSiblingElement ("node");
+    }
+}
+/*************************/
+bool DirNotebook::read (QDomDocument &doc, QVector<TextRange> &ranges)
+{
+    errorString_.clear();
+    ranges.clear();
+    order_.clear();
+    QFile file (filePath_);
+    if (!file.open (QIODevice::ReadOnly))
+    {
+        errorString_ = file.errorString();
+        return false;
+    }
+    FnxReader reader;
+    if (!reader.read (&file, doc))
+    {
+        errorString_ = reader.errorString();
+        return false;
+    }
+    file.close();
+    QDomElement root = doc.firstChildElement ("feathernotes");
+    if (root.isNull())
+    {
+        errorString_ = "Not a FeatherNotes notebook.";
+        doc = QDomDocument();
+        return false;
+    }
+    takeIds (root, ranges, order_);
+    scanDirs();
+    for (int i = 0; i < order_.count(); ++i)
+        lastId_ = qMax (lastId_, order_.at (i));
+
+    /* images are put where DomModel finds them */
+    QDir imagesDir (imagesPath (filePath_));
+    const QStringList names = imagesDir.entryList (QDir::Files);
+    if (!names.isEmpty())
+    {
+        QDomElement images = doc.createElement ("images");
+        for (const QString &name : names)
+        {
+            QFile image (imagesDir.filePath (name));
+            if (!image.open (QIODevice::ReadOnly)) continue;
+            QDomElement e = doc.createElement ("image");
+            e.setAttribute ("id", name);
+            e.appendChild (doc.createTextNode (QString::fromLatin1 (image.readAll().toBase64())));
+            images.appendChild (e);
+        }
+        root.appendChild (images);
+    }
+    return true;
+}
+/*************************/
+QString DirNotebook::text (qint64 offset, qint64 /*length*/) const
+{
+    const QString dir = dirOf (offset);
+    if (dir.isEmpty()) return QString();
+    QFile file (dir + "/text.html");
+    if (!file.open (QIODevice::ReadOnly))
+        return QString();
+    return QString::fromUtf8 (file.readAll());
+}
+/*************************/
+// An empty text has no file.
+bool DirNotebook::writeText (qint64 id, const QString &text)
+{
+    const QString dir = dirOf (id);
+    if (dir.isEmpty()) return false;
+    const QString path = dir + "/text.html";
+    if (text.isEmpty())
+    {
+        if (QFile::exists (path) && !QFile::remove (path))
+        {
+            errorString_ = "Cannot remove " + path;
+            return false;
+        }
+        return true;
+    }
+    AtomicFile file (path, false);
+    const QByteArray data = text.toUtf8();
+    if (!file.open() || file.device()->write (data) != data.size() || !file.commit())
+    {
+        errorString_ = "Cannot write " + path;
+        return false;
+    }
+    return true;
+}
+/*************************/
+bool DirNotebook::saveTexts (const QList<DomItem*> &items)
+{
+    errorString_.clear();
+    for (DomItem *item : items)
+    {
+        QHash<DomItem*, Row>::iterator it = rows_.find (item);
+        /* a new node needs the structure to be saved */
+        if (it == rows_.end()) return false;
+        if (it.value().generation != item->textGeneration())
+        {
+            if (!writeText (it.value().id, item->text()))
+                return false;
+            it.value().generation = item->textGeneration();
+        }
+    }
+    return true;
+}
+/*************************/
+// Puts the directory of the item inside that of its parent and
+// writes its text if it's new or changed. Its id is added to the
+// node of the manifest, which shouldn't have text.
+bool DirNotebook::placeItem (DomItem *item, const QString &parentDir,
+                             FnxSnapshot &manifest, int &index, QSet<qint64> &kept)
+{
+    FnxSnapshot::Node &node = manifest.nodes[index++];
+    node.text.clear();
+    node.source.clear();
+
+    QHash<DomItem*, Row>::iterator it = rows_.find (item);
+    const bool isNew = it == rows_.end();
+    const qint64 id = isNew ? ++lastId_ : it.value().id;
+    kept.insert (id);
+    node.attributes << qMakePair (QString ("id"), QString::number (id));
+
+    const QString dir = parentDir + "/" + QString::number (id);
+    const QString oldDir = dirOf (id);
+    if (oldDir != dir)
+    {
+        if (!oldDir.isEmpty() && QFileInfo (oldDir).isDir())
+        {
+            if (!QDir().rename (oldDir, dir))
+            {
+                errorString_ = "Cannot move " + oldDir;
+                return false;
+            }
+            moveDir (oldDir, dir);
+        }
+        else
+        {
+            if (!QDir().mkpath (dir))
+            {
+                errorString_ = "Cannot make " + dir;
+                return false;
+            }
+            QMutexLocker locker (&mutex_);
+            dirs_.insert (id, dir);
+        }
+    }
+
+    if (isNew)
+    {
+        if (!writeText (id, item->text()))
+            return false;
+        Row row;
+        row.id = id;
+        row.generation = item->textGeneration();
+        rows_.insert (item, row);
+        items_.insert (id, item);
+    }
+    else if (it.value().generation != item->textGeneration())
+    { // the text isn't read if it isn't changed
+        if (!writeText (id, item->text()))
+            return false;
+        it.value().generation = item->textGeneration();
+    }
+
+    for (int i = 0; i < item->childCount(); ++i)
+    {
+        if (!placeItem (item->child (i), dir, manifest, index, kept))
+            return false;
+    }
+    return true;
+}
+/*************************/
+// Only new images are written.
+bool DirNotebook::writeImages (DomModel *model)
+{
+    const QString path = imagesPath (filePath_);
+    const QHash<QString, QByteArray> images = model->imageStore.encodedImages();
+    QDir imagesDir (path);
+    if (images.isEmpty() && !imagesDir.exists())
+        return true;
+    if (!QDir().mkpath (path))
+    {
+        errorString_ = "Cannot make " + path;
+        return false;
+    }
+    QSet<QString> stored;
+    const QStringList names = imagesDir.entryList (QDir::Files);
+    for (const QString &name : names)
+        stored.insert (name);
+    QHash<QString, QByteArray>::const_iterator img;
+    for (img = images.constBegin(); img != images.constEnd(); ++img)
+    {
+        if (stored.remove (img.key())) continue;
+        AtomicFile file (imagesDir.filePath (img.key()), false);
+        const QByteArray data = QByteArray::fromBase64 (img.value());
+        if (!file.open() || file.device()->write (data) != data.size() || !file.commit())
+        {
+            errorString_ = "Cannot write " + imagesDir.filePath (img.key());
+            return false;
+        }
+    }
+    for (const QString &name : stored)
+        imagesDir.remove (name);
+    return true;
+}
+/*************************/
+// The manifest is written last, so that an interrupted saving leaves
+// the old notebook readable (its directories are found by scanning).
+bool DirNotebook::saveAll (DomModel *model)
+{
+    errorString_.clear();
+    const QString nodesDir = nodesPath (filePath_);
+    if (!QDir().mkpath (nodesDir))
+    {
+        errorString_ = "Cannot make " + nodesDir;
+        return false;
+    }
+    /* a new notebook replaces the nodes of an old one */
+    if (rows_.isEmpty())
+        scanDirs();
+
+    /* the rows are restored if saving fails (the directories that are
+       already moved or made are kept in "dirs_", as they are on the disk) */
+    const QHash<DomItem*, Row> oldRows = rows_;
+    const qint64 oldLastId = lastId_;
+
+    FnxSnapshot manifest = FnxWriter::snapshot (model);
+    manifest.images.clear();
+    QSet<qint64> kept;
+    int index = 0;
+    bool ok = true;
+    DomItem *rootItem = model->rootItem();
+    for (int i = 0; ok && i < rootItem->childCount(); ++i)
+        ok = placeItem (rootItem->child (i), nodesDir, manifest, index, kept);
+    if (ok)
+        ok = writeImages (model);
+    if (ok)
+    {
+        AtomicFile file (filePath_, false);
+        if (!file.open() || !FnxWriter::write (manifest, file.device()) || !file.commit())
+        {
+            errorString_ = "Cannot write " + filePath_;
+            ok = false;
+        }
+    }
+    if (!ok)
+    {
+        setRows (oldRows);
+        lastId_ = oldLastId;
+        return false;
+    }
+
+    /* remove the directories of removed nodes (those of kept nodes are moved out of them) */
+    QStringList removed;
+    {
+        QMutexLocker locker (&mutex_);
+        QHash<qint64, QString>::iterator it = dirs_.begin();
+        while (it != dirs_.end())
+        {
+            if (kept.contains (it.key()))
+                ++it;
+            else
+            {
+                removed << it.value();
+                it = dirs_.erase (it);
+            }
+        }
+    }
+    for (const QString &dir : removed)
+        QDir (dir).removeRecursively();
+    keepRows (kept);
+    return true;
+}
+
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIRNOTEBOOK_H
+#define DIRNOTEBOOK_H
+
+#include <QMutex>
+#include "notebook.h"
+
+namespace FeatherNotes {
+
+struct FnxSnapshot;
+
+// A document that is kept in a directory tree, beside a small manifest. The
+// manifest is an FNX document without node texts and images, which has the
+// order, names, tags and icons of nodes, and the id of each node as the "id"
+// attribute. In "<manifest>.nodes", each node has a directory with its id as
+// its name, inside the directory of its parent, and its text is in the file
+// "text.html" of that directory. Images are files in "<manifest>.images".
+//
+// Node texts are read only when they are needed, so that a huge notebook opens
+// quickly, and saving writes only the texts that have changed. Since a node is
+// found by its id, texts can be edited or kept under version control outside
+// FeatherNotes.
+class DirNotebook : public Notebook
+{
+public:
+    DirNotebook (const QString &filePath);
+
+    /* manifests are recognized by their extension */
+    static bool isNotebookPath (const QString &filePath) {
+        return filePath.endsWith (".fnd");
+    }
+    static QString nodesPath (const QString &filePath) {
+        return filePath + ".nodes";
+    }
+    static QString imagesPath (const QString &filePath) {
+        return filePath + ".images";
+    }
+
+    bool read (QDomDocument &doc, QVector<TextRange> &ranges);
+    bool saveTexts (const QList<DomItem*> &items);
+    bool saveAll (DomModel *model);
+
+    /* the offset of a text is the id of its node (thread-safe) */
+    QString text (qint64 offset, qint64 length) const;
+
+private:
+    void scanDirs();
+    QString dirOf (qint64 id) const;
+    void moveDir (const QString &from, const QString &to);
+    bool writeText (qint64 id, const QString &text);
+    bool placeItem (DomItem *item, const QString &parentDir,
+                    FnxSnapshot &manifest, int &index, QSet<qint64> &kept);
+    bool writeImages (DomModel *model);
+
+    mutable QMutex mutex_; // Guards the directories, which texts are read from in other threads.
+    QHash<qint64, QString> dirs_; // The directory of each node.
+    qint64 lastId_;
+};
+
+}
+
+#endif // DIRNOTEBOOK_H
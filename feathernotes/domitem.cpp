@@ -17,6 +17,7 @@
 
 #include <QtXml>
 #include "domitem.h"
+#include "textindex.h"
 
 namespace FeatherNotes {
 
@@ -26,13 +27,40 @@ DomItem::DomItem (QDomNode &node, int row, DomItem *parent)
     // Record the item's location within its parent.
     rowNumber = row;
     parentItem = parent;
+    textOffset = textLength = 0;
+    generation = 0;
+    hasPlain = plainExact = false;
+
+    /* all children are created here once, so that counting them or
+       getting one of them will not need any search in the DOM tree */
+    QDomElement e = containerNode().firstChildElement ("node");
+    while (!e.isNull())
+    {
+        childItems.append (new DomItem (e, childItems.count(), this));
+        e = e.nextSiblingElement ("node");
+    }
 }
 /*************************/
 DomItem::~DomItem()
 {
-    QHash<int,DomItem*>::iterator it;
-    for (it = childItems.begin(); it != childItems.end(); ++it)
-        delete it.value();
+    qDeleteAll (childItems);
+}
+/*************************/
+// The DOM node under which the nodes of the children are put.
+QDomNode DomItem::containerNode() const
+{
+    /* when this node is a QDomDocument, it's <feathernotes> */
+    QDomElement fn = domNode.firstChildElement ("feathernotes");
+    if (!fn.isNull())
+        return fn;
+    return domNode;
+}
+/*************************/
+// Correct the row numbers of the children after a change.
+void DomItem::updateRows (int from)
+{
+    for (int i = qMax (from, 0); i < childItems.count(); ++i)
+        childItems.at (i)->rowNumber = i;
 }
 /*************************/
 QDomNode DomItem::node() const
@@ -47,39 +75,14 @@ DomItem *DomItem::parent()
 /*************************/
 DomItem *DomItem::child (int i)
 {
-    if (childItems.contains (i))
-        return childItems[i];
-
-    int k = 0;
-    QDomNodeList list;
-    /* when this node is a QDomDocument... */
-    if (!domNode.firstChildElement ("feathernotes").isNull())
-        /* ... find the children of <feathernotes> */
-        list = domNode.firstChildElement ("feathernotes").childNodes();
-    else
-    {
-        list = domNode.childNodes();
-        /* if there's a text, it'll be the first child */
-        if (!list.isEmpty() && !list.at (0).isElement())
-            k = 1;
-    }
-    if (i >= 0 && i + k < list.count())
-    {
-        QDomNode childNode = list.item (i + k);
-        DomItem *childItem = new DomItem (childNode, i, this);
-        childItems[i] = childItem;
-        return childItem;
-    }
-
+    if (i >= 0 && i < childItems.count())
+        return childItems.at (i);
     return nullptr;
 }
 /*************************/
 int DomItem::childCount()
 {
-    int N = 0;
-    while (child (N))
-        ++N;
-    return N;
+    return childItems.count();
 }
 /*************************/
 int DomItem::row()
@@ -101,32 +104,21 @@ void DomItem::addChild (DomItem *item)
         itemNode = doc.documentElement();
     }
 
-    int k = 0;
-    QDomNodeList list;
-    if (!domNode.firstChildElement ("feathernotes").isNull())
-    {
-        domNode.firstChildElement ("feathernotes").appendChild (itemNode);
-        list = domNode.firstChildElement ("feathernotes").childNodes();
-    }
-    else
-    {
-        domNode.appendChild (itemNode);
-        list = domNode.childNodes();
-        if (!list.isEmpty() && !list.at (0).isElement())
-            k = 1;
-    }
+    containerNode().appendChild (itemNode);
 
     if (item)
     {
-        childItems[list.count() - k - 1] = item;
-        childItems[list.count() - k - 1]->rowNumber = list.count() - k - 1;
-        childItems[list.count() - k - 1]->parentItem = this;
+        item->rowNumber = childItems.count();
+        item->parentItem = this;
     }
+    else
+        item = new DomItem (itemNode, childItems.count(), this);
+    childItems.append (item);
 }
 /*************************/
 void DomItem::insertAt (int n, DomItem *item)
 {
-    if (n < 0 || n >= childCount()) return;
+    if (n < 0 || n >= childItems.count()) return;
 
     QDomNode itemNode;
     if (item)
@@ -138,230 +130,152 @@ void DomItem::insertAt (int n, DomItem *item)
         itemNode = doc.documentElement();
     }
 
-    int k = 0;
-    QDomNodeList list;
-    if (!domNode.firstChildElement ("feathernotes").isNull())
-    {
-        domNode.firstChildElement ("feathernotes").insertBefore (itemNode, child (n)->node());
-        list = domNode.firstChildElement ("feathernotes").childNodes();
-    }
-    else
-    {
-        domNode.insertBefore (itemNode, child (n)->node());
-        list = domNode.childNodes();
-        if (!list.isEmpty() && !list.at (0).isElement())
-            k = 1;
-    }
+    containerNode().insertBefore (itemNode, childItems.at (n)->node());
 
-    /* back up the nth value before creating it anew */
-    DomItem *tmp = childItems[n];
-    if (!item)
-    {
-        QDomNode childNode = list.item (n + k);
-        DomItem *childItem = new DomItem (childNode, n, this);
-        childItems[n] = childItem;
-    }
+    if (item)
+        item->parentItem = this;
     else
-    {
-        childItems[n] = item;
-        childItems[n]->rowNumber = n;
-        childItems[n]->parentItem = this;
-    }
-    /* now, move down the values for all indexes > n */
-    DomItem* tmp1 = nullptr;
-    for (int i = n + 1; i + k < list.count(); ++i)
-    {
-        if (childItems.contains (i))
-        {
-            tmp1 = childItems[i];
-            childItems[i] = tmp;
-            tmp = tmp1;
-        }
-        else // the last index
-            childItems[i] = tmp;
-        /* we only need to correct the row number */
-        childItems[i]->rowNumber = i;
-    }
+        item = new DomItem (itemNode, n, this);
+    childItems.insert (n, item);
+    /* move down the rows of all items with indexes >= n */
+    updateRows (n);
 }
 /*************************/
 void DomItem::moveUp (int n)
 {
-    if (n <= 0 || n >= childCount()) return;
+    if (n <= 0 || n >= childItems.count()) return;
 
-    if (!domNode.firstChildElement ("feathernotes").isNull())
-        domNode.firstChildElement ("feathernotes").insertBefore (child (n)->node(), child (n - 1)->node());
-    else
-        domNode.insertBefore (child (n)->node(), child (n - 1)->node());
+    containerNode().insertBefore (childItems.at (n)->node(), childItems.at (n - 1)->node());
 
-    DomItem *tmp = childItems[n - 1];
-    childItems[n - 1] = childItems[n];
-    childItems[n - 1]->rowNumber = n - 1;
-    childItems[n] = tmp;
-    childItems[n]->rowNumber = n;
+    childItems.move (n, n - 1);
+    childItems.at (n - 1)->rowNumber = n - 1;
+    childItems.at (n)->rowNumber = n;
 }
 /*************************/
 // Move the nth child of this item above it as its sibling.
 void DomItem::moveLeft (int n)
 {
-    if (n < 0 || n >= childCount()) return;
+    if (n < 0 || n >= childItems.count()) return;
 
     DomItem *p = parent();
     /* do nothing if this is the root row */
     if (!p) return;
 
-    int pK = 0;
-    QDomNodeList pList;
-    if (!p->domNode.firstChildElement ("feathernotes").isNull())
-    {
-        p->domNode.firstChildElement ("feathernotes").insertBefore (child (n)->node(), domNode);
-        pList = p->domNode.firstChildElement ("feathernotes").childNodes();
-    }
-    else
-    {
-        p->domNode.insertBefore (child (n)->node(), domNode);
-        pList = p->domNode.childNodes();
-        if (!pList.isEmpty() && !pList.at (0).isElement())
-            pK = 1;
-    }
-    int k = 0;
-    QDomNodeList list = domNode.childNodes();
-    if (!list.isEmpty() && !list.at (0).isElement())
-        k = 1;
-
-    /********************************
-       The child should be removed.
-          See takeChild() below.
-     ********************************/
+    p->containerNode().insertBefore (childItems.at (n)->node(), domNode);
 
-    /* first, back up the first child */
-    DomItem *del = childItems[n];
-    for (int i = n; i + k < list.count(); ++i)
-    {
-        childItems[i] = childItems[i + 1];
-        childItems[i]->rowNumber = i;
-    }
-    childItems.remove (list.count() - k);
-
-    /*********************************
-      A child should be inserted into
-      the parent's children at row().
-          See insertAt() above.
-     *********************************/
+    /* the child should be removed... */
+    DomItem *del = childItems.takeAt (n);
+    updateRows (n);
 
-    /* back up the item at row() */
-    DomItem *tmp = p->childItems[row()];
-
-    /* replace the item at row() with the backed-up
-       first child and correct its member variables */
-    p->childItems[row()] = del;
-    p->childItems[row()]->parentItem = p;
-    p->childItems[row()]->rowNumber = row();
-
-    DomItem* tmp1 = nullptr;
-    for (int i = row() + 1; i + pK < pList.count(); ++i)
-    {
-        if (p->childItems.contains (i))
-        {
-            tmp1 = p->childItems[i];
-            p->childItems[i] = tmp;
-            tmp = tmp1;
-        }
-        else
-            p->childItems[i] = tmp;
-        p->childItems[i]->rowNumber = i;
-    }
+    /* ... and inserted into the parent's children at row() */
+    int r = rowNumber;
+    del->parentItem = p;
+    p->childItems.insert (r, del);
+    p->updateRows (r);
 }
 /*************************/
 void DomItem::moveDown (int n)
 {
-    if (n < 0 || n >= childCount() - 1) return;
+    if (n < 0 || n >= childItems.count() - 1) return;
 
-    if (!domNode.firstChildElement ("feathernotes").isNull())
-        domNode.firstChildElement ("feathernotes").insertAfter (child (n)->node(), child (n + 1)->node());
-    else
-        domNode.insertAfter (child (n)->node(), child (n + 1)->node());
+    containerNode().insertAfter (childItems.at (n)->node(), childItems.at (n + 1)->node());
 
-    DomItem *tmp = childItems[n];
-    childItems[n] = childItems[n + 1];
-    childItems[n]->rowNumber = n;
-    childItems[n + 1] = tmp;
-    childItems[n + 1]->rowNumber = n + 1;
+    childItems.move (n, n + 1);
+    childItems.at (n)->rowNumber = n;
+    childItems.at (n + 1)->rowNumber = n + 1;
 }
 /*************************/
 // Make the nth child of this item the last child of the child above it.
 void DomItem::moveRight (int n)
 {
-    if (n <= 0 || n >= childCount()) return;
+    if (n <= 0 || n >= childItems.count()) return;
 
-    child (n - 1)->node().appendChild (child (n)->node());
-    // or: childItems[n - 1]->domNode.appendChild (childItems[n]->domNode);
-    int k = 0;
-    QDomNodeList list;
-    if (!domNode.firstChildElement ("feathernotes").isNull())
-        list = domNode.firstChildElement ("feathernotes").childNodes();
-    else
-    {
-        list = domNode.childNodes();
-        if (!list.isEmpty() && !list.at (0).isElement())
-            k = 1;
-    }
-    int cK = 0;
-    QDomNodeList cList = child (n - 1)->node().childNodes();
-    if (!cList.isEmpty() && !cList.at (0).isElement())
-        cK = 1;
+    DomItem *above = childItems.at (n - 1);
+    above->domNode.appendChild (childItems.at (n)->node());
 
-    /*****************************
-      The node should be removed
-     *****************************/
+    /* the node should be removed... */
+    DomItem *del = childItems.takeAt (n);
+    updateRows (n);
 
-    DomItem *del = childItems.value (n);
-    /* now, move up the values for all indexes >= n */
-    for (int i = n; i + k < list.count(); ++i)
-    {
-        childItems[i] = childItems[i + 1];
-        childItems[i]->rowNumber = i;
-    }
-    childItems.remove (list.count() - k);
-
-    /**************************************
-      A child should be inserted after all
-      children of the node above this one.
-     **************************************/
-
-    child (n - 1)->childItems[cList.count() - cK - 1] = del;
-    child (n - 1)->childItems[cList.count() - cK - 1]->parentItem = child (n - 1);
-    child (n - 1)->childItems[cList.count() - cK - 1]->rowNumber = cList.count() - cK - 1;
+    /* ... and inserted after all children of the node above it */
+    del->parentItem = above;
+    del->rowNumber = above->childItems.count();
+    above->childItems.append (del);
 }
 /*************************/
 DomItem *DomItem::takeChild (int n)
 {
-    if (n < 0 || n >= childCount()) return nullptr;
+    if (n < 0 || n >= childItems.count()) return nullptr;
 
-    int k = 0;
-    QDomNodeList list;
-    if (!domNode.firstChildElement ("feathernotes").isNull())
-    {
-        domNode.firstChildElement ("feathernotes").removeChild (child (n)->node());
-        list = domNode.firstChildElement ("feathernotes").childNodes();
-    }
+    containerNode().removeChild (childItems.at (n)->node());
+
+    DomItem *res = childItems.takeAt (n);
+    /* now, move up the rows of all items with indexes >= n */
+    updateRows (n);
+
+    return res;
+}
+
+/*************************/
+// The HTML text of this node, which is its first child.
+QString DomItem::text() const
+{
+    if (textSource)
+        return textSource->text (textOffset, textLength);
+    QDomNode first = domNode.firstChild();
+    if (first.isText())
+        return first.nodeValue();
+    return QString();
+}
+/*************************/
+void DomItem::setText (const QString &txt)
+{
+    textChanged();
+    textSource.clear();
+    QDomNode first = domNode.firstChild();
+    if (first.isText())
+        /* if this node's first child is a text node, replace its text... */
+        first.setNodeValue (txt);
     else
     {
-        domNode.removeChild (child (n)->node());
-        list = domNode.childNodes();
-        if (!list.isEmpty() && !list.at (0).isElement())
-            k = 1;
+        /* ... otherwise, insert a text node before the first child (if any) */
+        QDomText t = domNode.ownerDocument().createTextNode (txt);
+        domNode.insertBefore (t, first);
     }
-
-    DomItem *res = childItems.value (n);
-    /* now, move up the values for all indexes >= n */
-    for (int i = n; i + k < list.count(); ++i)
+}
+/*************************/
+void DomItem::setTextSource (const QSharedPointer<TextSource> &source, qint64 offset, qint64 length)
+{
+    textChanged();
+    textSource = source;
+    textOffset = offset;
+    textLength = length;
+}
+/*************************/
+void DomItem::textChanged()
+{
+    ++generation;
+    hasPlain = false;
+    plain.clear();
+}
+/*************************/
+QString DomItem::plainText (bool *exact) const
+{
+    if (!hasPlain)
     {
-        childItems[i] = childItems[i + 1];
-        childItems[i]->rowNumber = i;
+        plain = TextIndex::plainText (text(), &plainExact);
+        hasPlain = true;
     }
-    childItems.remove (list.count() - k);
-
-    return res;
+    if (exact) *exact = plainExact;
+    return plain;
+}
+/*************************/
+void DomItem::setPlainText (quint32 gen, const QString &txt, bool exact)
+{
+    if (gen != generation) return; // the text is changed in the meantime
+    plain = txt;
+    plainExact = exact;
+    hasPlain = true;
 }
 
 }
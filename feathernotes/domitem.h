@@ -19,7 +19,9 @@
 #define DOMITEM_H
 
 #include <QDomNode>
-#include <QHash>
+#include <QVector>
+#include <QSharedPointer>
+#include "textsource.h"
 
 namespace FeatherNotes {
 
@@ -41,11 +43,52 @@ public:
     void moveRight (int n);
     DomItem *takeChild(int n);
 
+    QString text() const;
+    void setText (const QString &txt);
+    /* the text will be read from the source until it's set by setText() */
+    void setTextSource (const QSharedPointer<TextSource> &source, qint64 offset, qint64 length);
+    bool hasLazyText() const {
+        return !textSource.isNull();
+    }
+    QSharedPointer<TextSource> lazyTextSource() const {
+        return textSource;
+    }
+    TextRange lazyTextRange() const {
+        TextRange range;
+        range.offset = textOffset;
+        range.length = textLength;
+        return range;
+    }
+
+    /* the plain text, cached until the text is changed ("exact" becomes
+       false if the HTML text couldn't be converted exactly) */
+    QString plainText (bool *exact = nullptr) const;
+    bool hasPlainText() const {
+        return hasPlain;
+    }
+    /* increases whenever the text is changed */
+    quint32 textGeneration() const {
+        return generation;
+    }
+    /* caches a plain text that is made elsewhere from a generation of the text */
+    void setPlainText (quint32 gen, const QString &txt, bool exact);
+
 private:
+    QDomNode containerNode() const;
+    void updateRows (int from);
+    void textChanged();
+
     QDomNode domNode;
-    QHash<int,DomItem*> childItems;
+    QVector<DomItem*> childItems;
     DomItem *parentItem;
     int rowNumber;
+    QSharedPointer<TextSource> textSource;
+    qint64 textOffset;
+    qint64 textLength;
+    quint32 generation;
+    mutable bool hasPlain;
+    mutable bool plainExact;
+    mutable QString plain;
 };
 
 }
@@ -27,6 +27,20 @@ DomModel::DomModel (QDomDocument document, QObject *parent) :
     QAbstractItemModel (parent), domDocument (document),
     dropIndex_ (QModelIndex()), dropRow_ (-1), dragged_ (nullptr)
 {
+    /* the stored images are kept out of the DOM tree */
+    QDomElement root = domDocument.firstChildElement ("feathernotes");
+    QDomElement images = root.firstChildElement ("images");
+    if (!images.isNull())
+    {
+        QDomElement e = images.firstChildElement ("image");
+        while (!e.isNull())
+        {
+            imageStore.insertEncoded (e.attribute ("id"), e.text().toLatin1());
+            e = e.nextSiblingElement ("image");
+        }
+        root.removeChild (images);
+    }
+
     rootItem_ = new DomItem (domDocument, 0);
 }
 /*************************/
@@ -184,6 +198,14 @@ bool DomModel::insertRows (int row, int count, const QModelIndex &parent)
     return true;
 }
 /*************************/
+// Removes an item and its descendants from the search index before deletion.
+void DomModel::unindex (DomItem *item)
+{
+    for (int i = 0; i < item->childCount(); ++i)
+        unindex (item->child (i));
+    textIndex.remove (item);
+}
+/*************************/
 bool DomModel::removeRows (int row, int count, const QModelIndex &parent)
 {
     if (row < 0 || rowCount (parent) == 0)
@@ -215,6 +237,7 @@ bool DomModel::removeRows (int row, int count, const QModelIndex &parent)
         if (dropRow_ == -1)
         {
             /* no DND but deletion */
+            unindex (dragged_);
             delete dragged_;
             dragged_ = nullptr;
         }
@@ -395,4 +418,39 @@ QModelIndex DomModel::adjacentIndex (const QModelIndex &indx, bool down) const
     return rslt;
 }
 
+/*************************/
+static void setItemTextSources (DomItem *item, const QSharedPointer<TextSource> &source,
+                                const QVector<TextRange> &ranges, int &i)
+{
+    for (int r = 0; r < item->childCount() && i < ranges.count(); ++r)
+    {
+        DomItem *child = item->child (r);
+        const TextRange &range = ranges.at (i++);
+        if (range.offset >= 0)
+            child->setTextSource (source, range.offset, range.length);
+        setItemTextSources (child, source, ranges, i);
+    }
+}
+/*************************/
+// Give the nodes their text ranges, which are in the order of nodes in the file.
+void DomModel::setTextSource (const QSharedPointer<TextSource> &source, const QVector<TextRange> &ranges)
+{
+    int i = 0;
+    setItemTextSources (rootItem_, source, ranges, i);
+}
+/*************************/
+static void detachItemTexts (DomItem *item)
+{
+    if (item->hasLazyText())
+        item->setText (item->text());
+    for (int r = 0; r < item->childCount(); ++r)
+        detachItemTexts (item->child (r));
+}
+/*************************/
+// Put all texts that are read from a source into the DOM tree.
+void DomModel::detachTexts()
+{
+    detachItemTexts (rootItem_);
+}
+
 }
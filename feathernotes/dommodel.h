@@ -22,6 +22,11 @@
 #include <QDomDocument>
 #include <QModelIndex>
 #include <QVariant>
+#include <QVector>
+#include <QSharedPointer>
+#include "textsource.h"
+#include "imagestore.h"
+#include "textindex.h"
 
 namespace FeatherNotes {
 
@@ -55,7 +60,15 @@ public:
     QModelIndexList allDescendants (const QModelIndex &ancestor) const;
     QModelIndex adjacentIndex (const QModelIndex &indx, bool down) const;
 
+    void setTextSource (const QSharedPointer<TextSource> &source, const QVector<TextRange> &ranges);
+    void detachTexts();
+    DomItem *rootItem() const {
+        return rootItem_;
+    }
+
     QDomDocument domDocument;
+    ImageStore imageStore;
+    TextIndex textIndex;
 
 signals:
     void treeChanged(); // For informing the user.
@@ -63,6 +76,8 @@ signals:
     void droppedAtIndex (const QModelIndex &droppedIndex);
 
 private:
+    void unindex (DomItem *item);
+
     DomItem *rootItem_;
     /* DND variables: */
     QModelIndex dropIndex_;
@@ -2,7 +2,8 @@ QT += core gui \
       xml \
       widgets \
       printsupport \
-      svg
+      svg \
+      concurrent
 
 haiku|macx {
   TARGET = FeatherNotes
@@ -23,6 +24,19 @@ SOURCES += main.cpp\
            pref.cpp \
            textedit.cpp \
            simplecrypt.cpp \
+           decryptchain.cpp \
+           fnxcipher.cpp \
+           fnxreader.cpp \
+           fnxwriter.cpp \
+           fnbfile.cpp \
+           notebook.cpp \
+           dirnotebook.cpp \
+           journal.cpp \
+           atomicfile.cpp \
+           imagestore.cpp \
+           textindex.cpp \
+           fuzzymatch.cpp \
+           streammatch.cpp \
            vscrollbar.cpp \
            svgicons.cpp
 
@@ -34,6 +48,20 @@ HEADERS += fn.h \
            pref.h \
            spinbox.h \
            simplecrypt.h \
+           decryptchain.h \
+           fnxcipher.h \
+           fnxreader.h \
+           fnxwriter.h \
+           fnbfile.h \
+           notebook.h \
+           dirnotebook.h \
+           journal.h \
+           atomicfile.h \
+           imagestore.h \
+           textindex.h \
+           fuzzymatch.h \
+           streammatch.h \
+           textsource.h \
            vscrollbar.h \
            settings.h \
            help.h \
@@ -49,6 +77,14 @@ FORMS += fn.ui \
 
 RESOURCES += data/fn.qrc
 
+contains(WITH_SQLITE, YES) {
+  message("Compiling with SQLite notebooks...")
+  QT += sql
+  SOURCES += sqlitenotebook.cpp
+  HEADERS += sqlitenotebook.h
+  DEFINES += HAS_SQLITE
+}
+
 contains(WITHOUT_X11, YES) {
   message("Compiling without X11...")
 }
@@ -18,8 +18,15 @@
 #include "fn.h"
 #include "ui_fn.h"
 #include "dommodel.h"
+#include "fuzzymatch.h"
+#include "streammatch.h"
 #include <QTextBlock>
 #include <QTextDocumentFragment>
+#include <QToolTip>
+#include <QApplication>
+#include <QRegularExpression>
+#include <QtConcurrentMap>
+#include <algorithm>
 
 namespace FeatherNotes {
 
@@ -98,226 +105,382 @@ QTextCursor FN::finding (const QString& str,
                          QTextDocument::FindFlags flags) const
 {
     /* let's be consistent first */
-    if (ui->stackedWidget->currentIndex() == -1 || str.isEmpty())
+    if (ui->stackedWidget->currentIndex() == -1)
         return QTextCursor(); // null cursor
 
     TextEdit *textEdit = qobject_cast< TextEdit *>(ui->stackedWidget->currentWidget());
-    QTextDocument *txtdoc = textEdit->document();
+    return finding (textEdit->document(), str, start, flags);
+}
+/*************************/
+// Searches a document that may not belong to the current node or to any editor.
+QTextCursor FN::finding (QTextDocument *txtdoc,
+                         const QString& str,
+                         const QTextCursor& start,
+                         QTextDocument::FindFlags flags)
+{
+    if (str.isEmpty())
+        return QTextCursor();
+
     QTextCursor res = QTextCursor (start);
     if (str.contains ('\n'))
     {
-        QTextCursor cursor = start;
-        QTextCursor found;
-        QStringList sl = str.split ("\n");
-        int i = 0;
-        Qt::CaseSensitivity cs = !(flags & QTextDocument::FindCaseSensitively)
-                                 ? Qt::CaseInsensitive : Qt::CaseSensitive;
-        QString subStr;
         if (!(flags & QTextDocument::FindBackward))
+            res = findForwardInStream (txtdoc, str, start.selectionEnd(), flags);
+        else
+            res = findBackwardInStream (txtdoc, str, start.anchor(), flags);
+    }
+    else // there's no line break
+    {
+        if (!(flags & QTextDocument::FindBackward))
+            res = txtdoc->find (str, start, flags);
+        else
+            findBackward (txtdoc, str, res, flags);
+    }
+
+    return res;
+}
+/*************************/
+// Builds the search index of node texts when it's needed for the first time
+// and updates it with the texts that are edited since then.
+void FN::updateTextIndex()
+{
+    TextIndex &index = model_->textIndex;
+    if (!index.isBuilt())
+    {
+        QApplication::setOverrideCursor (Qt::WaitCursor);
+        QModelIndex indx = model_->index (0, 0);
+        while (indx.isValid())
         {
-            /* this loop searches for the consecutive
-               occurrences of newline separated strings */
-            while (i < sl.count())
+            DomItem *item = static_cast<DomItem*>(indx.internalPointer());
+            if (!editorOf (item))
             {
-                if (i == 0) // the first string
-                {
-                    subStr = sl.at (0);
-                    /* when the first string is empty... */
-                    if (subStr.isEmpty())
-                    {
-                        /* ... search anew from the next block */
-                        cursor.movePosition (QTextCursor::EndOfBlock);
-                        res.setPosition (cursor.position());
-                        if (!cursor.movePosition (QTextCursor::NextBlock))
-                            return QTextCursor();
-                        ++i;
-                    }
-                    else
-                    {
-                        if ((found = txtdoc->find (subStr, cursor, flags)).isNull())
-                            return QTextCursor();
-                        cursor.setPosition (found.position());
-                        /* if the match doesn't end the block... */
-                        while (!cursor.atBlockEnd())
-                        {
-                            /* ... move the cursor to right and search until a match is found */
-                            cursor.movePosition (QTextCursor::EndOfBlock);
-                            cursor.setPosition (cursor.position() - subStr.length());
-                            if ((found = txtdoc->find (subStr, cursor, flags)).isNull())
-                                return QTextCursor();
-                            cursor.setPosition (found.position());
-                        }
-
-                        res.setPosition (found.anchor());
-                        if (!cursor.movePosition (QTextCursor::NextBlock))
-                            return QTextCursor();
-                        ++i;
-                    }
-                }
-                else if (i != sl.count() - 1) // middle strings
-                {
-                    /* when the next block's test isn't the next string... */
-                    if (QString::compare (cursor.block().text(), sl.at (i), cs) != 0)
-                    {
-                        /* ... reset the loop cautiously */
-                        cursor.setPosition (res.position());
-                        if (!cursor.movePosition (QTextCursor::NextBlock))
-                            return QTextCursor();
-                        i = 0;
-                        continue;
-                    }
-
-                    if (!cursor.movePosition (QTextCursor::NextBlock))
-                        return QTextCursor();
-                    ++i;
-                }
-                else // the last string (i == sl.count() - 1)
-                {
-                    subStr = sl.at (i);
-                    if (subStr.isEmpty()) break;
-                    if (!(flags & QTextDocument::FindWholeWords))
-                    {
-                        /* when the last string doesn't start the next block... */
-                        if (!cursor.block().text().startsWith (subStr, cs))
-                        {
-                            /* ... reset the loop cautiously */
-                            cursor.setPosition (res.position());
-                            if (!cursor.movePosition (QTextCursor::NextBlock))
-                                return QTextCursor();
-                            i = 0;
-                            continue;
-                        }
-                        cursor.setPosition (cursor.anchor() + subStr.count());
-                        break;
-                    }
-                    else
-                    {
-                        if ((found = txtdoc->find (subStr, cursor, flags)).isNull()
-                            || found.anchor() != cursor.position())
-                        {
-                            cursor.setPosition (res.position());
-                            if (!cursor.movePosition (QTextCursor::NextBlock))
-                                return QTextCursor();
-                            i = 0;
-                            continue;
-                        }
-                        cursor.setPosition (found.position());
-                        break;
-                    }
-                }
+                bool ok;
+                const QString text = item->plainText (&ok);
+                if (ok) // otherwise, the node will always be searched
+                    index.update (item, text);
             }
-            res.setPosition (cursor.position(), QTextCursor::KeepAnchor);
+            indx = model_->adjacentIndex (indx, true);
         }
-        else // backward search
+        index.setBuilt (true);
+        QApplication::restoreOverrideCursor();
+    }
+
+    QHash<DomItem*, NodeSession>::const_iterator it;
+    for (it = sessions_.constBegin(); it != sessions_.constEnd(); ++it)
+    {
+        const TextEdit *textEdit = it.value().editor;
+        if (!textEdit) continue;
+        const int revision = textEdit->document()->revision();
+        if (index.stamp (it.key()) != revision)
+            index.update (it.key(), textEdit->toPlainText(), revision);
+    }
+}
+/*************************/
+// The text of a node is read only if the search index can't rule it out.
+bool FN::nodeContains (DomItem *item, const QString &str, Qt::CaseSensitivity cs) const
+{
+    if (!model_->textIndex.mayContain (item, str))
+        return false;
+    if (TextEdit *textEdit = editorOf (item))
+        return textEdit->toPlainText().contains (str, cs); // the node text may have been edited
+    bool ok;
+    const QString text = item->plainText (&ok);
+    return !ok || text.contains (str, cs);
+}
+/*************************/
+/* the text of a node that should be searched by "Find All" */
+struct FindAllJob
+{
+    QString text;
+    bool isHtml;
+    /* a text that isn't read yet */
+    QSharedPointer<TextSource> source;
+    TextRange range;
+};
+
+/* finds all matches in the text of a node, in another thread */
+struct FindAllMatcher
+{
+    typedef QVector<FindAllMatch> result_type;
+
+    enum Mode {
+        Literal,
+        RegExp,
+        Fuzzy
+    };
+
+    Mode mode;
+    QString str;
+    Qt::CaseSensitivity cs;
+    bool wholeWords;
+    /* compiled and optimized once; it's thread-safe */
+    QRegularExpression regex;
+
+    result_type operator() (const FindAllJob &job) const
+    {
+        static const int maxMatches = 1000;
+        QString text;
+        if (job.source)
+            text = TextIndex::plainText (job.source->text (job.range.offset, job.range.length));
+        else
+            text = job.isHtml ? TextIndex::plainText (job.text) : job.text;
+        text.replace (QChar::Nbsp, QLatin1Char (' '));
+
+        result_type res;
+        if (mode == RegExp)
         {
-            cursor.setPosition (cursor.anchor());
-            int endPos = cursor.position();
-            while (i < sl.count())
+            QRegularExpressionMatchIterator it = regex.globalMatch (text);
+            while (res.count() < maxMatches && it.hasNext())
             {
-                if (i == 0) // the last string
-                {
-                    subStr = sl.at (sl.count() - 1);
-                    if (subStr.isEmpty())
-                    {
-                        cursor.movePosition (QTextCursor::StartOfBlock);
-                        endPos = cursor.position();
-                        if (!cursor.movePosition (QTextCursor::PreviousBlock))
-                            return QTextCursor();
-                        cursor.movePosition (QTextCursor::EndOfBlock);
-                        ++i;
-                    }
-                    else
-                    {
-                        if (!findBackward (txtdoc, subStr, cursor, flags))
-                            return QTextCursor();
-                        /* if the match doesn't start the block... */
-                        while (cursor.anchor() > cursor.block().position())
-                        {
-                            /* ... move the cursor to left and search backward until a match is found */
-                            cursor.setPosition (cursor.block().position() + subStr.count());
-                            if (!findBackward (txtdoc, subStr, cursor, flags))
-                                return QTextCursor();
-                        }
-
-                        endPos = cursor.position();
-                        if (!cursor.movePosition (QTextCursor::PreviousBlock))
-                            return QTextCursor();
-                        cursor.movePosition (QTextCursor::EndOfBlock);
-                        ++i;
-                    }
-                }
-                else if (i != sl.count() - 1) // the middle strings
+                const QRegularExpressionMatch match = it.next();
+                if (match.capturedLength() > 0)
+                    addMatch (res, text, match.capturedStart(), match.capturedLength(), 0);
+            }
+        }
+        else if (mode == Fuzzy && str.length() <= 64)
+            fuzzyMatches (res, text, maxMatches);
+        else
+        {
+            int from = 0, idx;
+            while (res.count() < maxMatches && (idx = text.indexOf (str, from, cs)) != -1)
+            {
+                from = idx + 1;
+                const int end = idx + str.length();
+                if (wholeWords
+                    && ((idx != 0 && text.at (idx - 1).isLetterOrNumber())
+                        || (end != text.length() && text.at (end).isLetterOrNumber())))
                 {
-                    if (QString::compare (cursor.block().text(), sl.at (sl.count() - i - 1), cs) != 0)
-                    { // reset the loop if the block text doesn't match
-                        cursor.setPosition (endPos);
-                        if (!cursor.movePosition (QTextCursor::PreviousBlock))
-                            return QTextCursor();
-                        cursor.movePosition (QTextCursor::EndOfBlock);
-                        i = 0;
-                        continue;
-                    }
-
-                    if (!cursor.movePosition (QTextCursor::PreviousBlock))
-                        return QTextCursor();
-                    cursor.movePosition (QTextCursor::EndOfBlock);
-                    ++i;
+                    continue;
                 }
-                else // the first string
+                addMatch (res, text, idx, str.length(), 0);
+                from = end;
+            }
+        }
+
+        if (mode != Literal)
+        {
+            /* a match will be selected by finding its text literally, so the
+               occurrences of the same text before it should be counted */
+            QHash<QString, QPair<int, int> > counted; // text -> (searched up to, count)
+            for (auto &match : res)
+            {
+                QPair<int, int> &c = counted[match.text];
+                int idx;
+                while ((idx = text.indexOf (match.text, c.first, Qt::CaseSensitive)) != -1
+                       && idx < match.position)
                 {
-                    subStr = sl.at (0);
-                    if (subStr.isEmpty()) break;
-                    if (!(flags & QTextDocument::FindWholeWords))
-                    {
-                        /* when the first string doesn't end the previous block... */
-                        if (!cursor.block().text().endsWith (subStr, cs))
-                        {
-                            /* ... reset the loop */
-                            cursor.setPosition (endPos);
-                            if (!cursor.movePosition (QTextCursor::PreviousBlock))
-                                return QTextCursor();
-                            cursor.movePosition (QTextCursor::EndOfBlock);
-                            i = 0;
-                            continue;
-                        }
-                        cursor.setPosition (cursor.anchor() - subStr.count());
-                        break;
-                    }
-                    else
-                    {
-                        found = cursor; // block end
-                        if (!findBackward (txtdoc, subStr, found, flags)
-                            || found.position() != cursor.position())
-                        {
-                            cursor.setPosition (endPos);
-                            if (!cursor.movePosition (QTextCursor::PreviousBlock))
-                                return QTextCursor();
-                            cursor.movePosition (QTextCursor::EndOfBlock);
-                            i = 0;
-                            continue;
-                        }
-                        cursor.setPosition (found.anchor());
-                        break;
-                    }
+                    ++ c.second;
+                    c.first = idx + match.text.length();
                 }
+                match.ordinal = c.second;
             }
-            res.setPosition (cursor.anchor());
-            res.setPosition (endPos, QTextCursor::KeepAnchor);
         }
+        return res;
     }
-    else // there's no line break
+
+private:
+    void addMatch (result_type &res, const QString &text, int pos, int length, int score) const
     {
-        if (!(flags & QTextDocument::FindBackward))
-            res = txtdoc->find (str, start, flags);
-        else
-            findBackward (txtdoc, str, res, flags);
+        static const int context = 30;
+        const int end = pos + length;
+        const int start = qMax (0, pos - context);
+        FindAllMatch match;
+        match.text = text.mid (pos, length);
+        match.position = pos;
+        match.ordinal = res.count();
+        match.score = score;
+        match.snippet = text.mid (start, end + context - start).simplified();
+        if (start > 0)
+            match.snippet.prepend (QChar (0x2026));
+        if (end + context < text.length())
+            match.snippet.append (QChar (0x2026));
+        res.append (match);
     }
 
-    return res;
+    void fuzzyMatches (result_type &res, const QString &text, int maxMatches) const
+    {
+        const QVector<FuzzyMatch> matches = fuzzyFind (text, str, cs, maxMatches);
+        for (const auto &match : matches)
+            addMatch (res, text, match.position, match.length, match.typos);
+    }
+};
+/*************************/
+// Searches all nodes in other threads and lists the matches in a dock as they're found.
+void FN::findAll()
+{
+    if (!ui->lineEdit->isVisible())
+        showHideSearch();
+    const QString txt = ui->lineEdit->text();
+    if (txt.isEmpty())
+    {
+        ui->lineEdit->setFocus();
+        return;
+    }
+
+    cancelFindAll();
+    findAllWatcher_->waitForFinished();
+    ui->findAllList->clear();
+    findAllNodes_.clear();
+
+    reallySetSearchFlags (false);
+    FindAllMatcher matcher;
+    matcher.mode = ui->regexButton->isChecked() ? FindAllMatcher::RegExp
+                   : ui->fuzzyButton->isChecked() ? FindAllMatcher::Fuzzy
+                                                  : FindAllMatcher::Literal;
+    matcher.str = txt;
+    matcher.cs = searchFlags_.testFlag (QTextDocument::FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    matcher.wholeWords = searchFlags_.testFlag (QTextDocument::FindWholeWords);
+    if (matcher.mode == FindAllMatcher::RegExp)
+    {
+        QRegularExpression::PatternOptions options = QRegularExpression::UseUnicodePropertiesOption
+                                                     | QRegularExpression::MultilineOption;
+        if (matcher.cs == Qt::CaseInsensitive)
+            options |= QRegularExpression::CaseInsensitiveOption;
+        matcher.regex = QRegularExpression (matcher.wholeWords ? "\\b(?:" + txt + ")\\b" : txt, options);
+        if (!matcher.regex.isValid())
+        {
+            ui->dockFindAll->setWindowTitle (tr ("Invalid regular expression"));
+            ui->dockFindAll->setVisible (true);
+            ui->dockFindAll->raise();
+            return;
+        }
+        matcher.regex.optimize();
+    }
+    /* matches found by a pattern are selected by their exact texts */
+    findAllFlags_ = matcher.mode == FindAllMatcher::Literal ? searchFlags_
+                                                            : QTextDocument::FindCaseSensitively;
+
+    /* node texts are read here only if they are in memory,
+       and the word index can only narrow down literal searches */
+    const bool useIndex = matcher.mode == FindAllMatcher::Literal && model_->textIndex.isBuilt();
+    if (useIndex)
+        updateTextIndex();
+    QVector<FindAllJob> jobs;
+    QModelIndex indx = model_->index (0, 0);
+    while (indx.isValid())
+    {
+        DomItem *item = static_cast<DomItem*>(indx.internalPointer());
+        if (!useIndex || model_->textIndex.mayContain (item, txt))
+        {
+            FindAllJob job;
+            job.isHtml = true;
+            job.range.offset = job.range.length = 0;
+            if (TextEdit *textEdit = editorOf (item))
+            {
+                job.text = textEdit->toPlainText(); // the node text may have been edited
+                job.isHtml = false;
+            }
+            else if (item->hasPlainText())
+            {
+                job.text = item->plainText();
+                job.isHtml = false;
+            }
+            else if (item->hasLazyText())
+            {
+                job.source = item->lazyTextSource();
+                job.range = item->lazyTextRange();
+            }
+            else
+                job.text = item->text();
+            jobs.append (job);
+            findAllNodes_.append (QPersistentModelIndex (indx));
+        }
+        indx = model_->adjacentIndex (indx, true);
+    }
+
+    ui->dockFindAll->setWindowTitle (tr ("Searching..."));
+    ui->dockFindAll->setVisible (true);
+    ui->dockFindAll->raise();
+    findAllWatcher_->setFuture (QtConcurrent::mapped (jobs, matcher));
+}
+/*************************/
+void FN::findAllResultReady (int index)
+{
+    const QPersistentModelIndex node = findAllNodes_.value (index);
+    if (!node.isValid()) return; // the node is removed
+    const QVector<FindAllMatch> matches = findAllWatcher_->resultAt (index);
+    if (matches.isEmpty()) return;
+
+    /* results may come in any order but they're listed in the order of
+       nodes, and fuzzy matches with fewer typos come first */
+    const QString address = nodeAddress (node);
+    for (const auto &match : matches)
+    {
+        int row = ui->findAllList->count();
+        int first = 0;
+        while (first < row)
+        {
+            const int middle = (first + row) / 2;
+            const QListWidgetItem *other = ui->findAllList->item (middle);
+            const int score = other->data (Qt::UserRole + 3).toInt();
+            if (score < match.score
+                || (score == match.score && other->data (Qt::UserRole).toInt() <= index))
+            {
+                first = middle + 1;
+            }
+            else
+                row = middle;
+        }
+        QListWidgetItem *item = new QListWidgetItem (address + ": " + match.snippet);
+        item->setData (Qt::UserRole, index);
+        item->setData (Qt::UserRole + 1, match.ordinal);
+        item->setData (Qt::UserRole + 2, match.text);
+        item->setData (Qt::UserRole + 3, match.score);
+        ui->findAllList->insertItem (row, item);
+    }
+}
+/*************************/
+void FN::findAllFinished()
+{
+    if (findAllWatcher_->isCanceled()) return;
+    const int matches = ui->findAllList->count();
+    if (matches > 1)
+        ui->dockFindAll->setWindowTitle (tr ("%1 Matches").arg (matches));
+    else if (matches == 1)
+        ui->dockFindAll->setWindowTitle (tr ("One Match"));
+    else
+        ui->dockFindAll->setWindowTitle (tr ("No Match"));
+}
+/*************************/
+// The search is canceled when the search text is changed.
+void FN::cancelFindAll()
+{
+    if (findAllWatcher_->isRunning())
+    {
+        findAllWatcher_->cancel();
+        ui->dockFindAll->setWindowTitle (tr ("Find All"));
+    }
+}
+/*************************/
+void FN::findAllActivated (QListWidgetItem *item)
+{
+    const QPersistentModelIndex node = findAllNodes_.value (item->data (Qt::UserRole).toInt());
+    if (!node.isValid()) return;
+    ui->treeView->setCurrentIndex (node);
+    endPreview();
+    QWidget *cw = ui->stackedWidget->currentWidget();
+    if (!cw) return;
+    TextEdit *textEdit = qobject_cast< TextEdit *>(cw);
+
+    /* select the match by counting the matches before it */
+    const int n = item->data (Qt::UserRole + 1).toInt();
+    const QString txt = item->data (Qt::UserRole + 2).toString();
+    QTextCursor start = textEdit->textCursor();
+    start.movePosition (QTextCursor::Start);
+    QTextCursor found;
+    for (int i = 0; i <= n; ++i)
+    {
+        found = finding (txt, start, findAllFlags_);
+        if (found.isNull()) return;
+        start.setPosition (found.position());
+    }
+    textEdit->setTextCursor (found);
+    textEdit->setFocus();
 }
 /*************************/
 void FN::find()
 {
+    endPreview();
     QWidget *cw = ui->stackedWidget->currentWidget();
     if (!cw) return;
 
@@ -335,18 +498,27 @@ void FN::find()
         return;
     }
 
+    /* regex and fuzzy matches are listed for all nodes */
+    if (ui->regexButton->isChecked() || ui->fuzzyButton->isChecked())
+    {
+        findAll();
+        return;
+    }
+
     TextEdit *textEdit = qobject_cast< TextEdit *>(cw);
     disconnect (textEdit->verticalScrollBar(), &QAbstractSlider::valueChanged, this, &FN::scrolled);
     disconnect (textEdit->horizontalScrollBar(), &QAbstractSlider::valueChanged, this, &FN::scrolled);
-    disconnect (textEdit, &TextEdit::resized, this, &FN::hlight);
-    disconnect (textEdit, &QTextEdit::textChanged, this, &FN::hlight);
+    disconnect (textEdit, &TextEdit::resized, this, &FN::scheduleHlight);
+    disconnect (textEdit, &QTextEdit::textChanged, this, &FN::scheduleHlight);
     QString txt = ui->lineEdit->text();
-    searchEntries_[textEdit] = txt;
+    NodeSession *session = currentSession();
+    const bool newSearch = session->searchEntry != txt;
+    session->searchEntry = txt;
     if (txt.isEmpty())
     {
         /* remove all yellow and green highlights */
         QList<QTextEdit::ExtraSelection> extraSelections;
-        greenSels_[textEdit] = extraSelections; // not needed
+        session->greenSels = extraSelections; // not needed
         textEdit->setExtraSelections (extraSelections);
         return;
     }
@@ -367,6 +539,21 @@ void FN::find()
     searchingOtherNode_ = false;
 
     reallySetSearchFlags (false);
+    if (newSearch && ui->everywhereButton->isChecked() && model_->rowCount() > 1)
+    { // show the number of nodes that may contain the text
+        updateTextIndex();
+        int n = 0;
+        QModelIndex indx = model_->index (0, 0);
+        while (indx.isValid())
+        {
+            if (model_->textIndex.mayContain (static_cast<DomItem*>(indx.internalPointer()), txt))
+                ++n;
+            indx = model_->adjacentIndex (indx, true);
+        }
+        QToolTip::showText (ui->lineEdit->mapToGlobal (QPoint (0, ui->lineEdit->height())),
+                            tr ("%n node(s) may contain the text", "", n),
+                            ui->lineEdit);
+    }
     QTextDocument::FindFlags newFlags = searchFlags_;
     if (backwardSearch)
         newFlags = searchFlags_ | QTextDocument::FindBackward;
@@ -388,11 +575,12 @@ void FN::find()
         {
             /* go to the next node... */
             nxtIndx = ui->treeView->currentIndex();
-            QString text;
             /* ... but skip nodes that don't contain the search string */
             Qt::CaseSensitivity cs = Qt::CaseInsensitive;
             if (ui->caseButton->isChecked()) cs = Qt::CaseSensitive;
-            while (!text.contains (txt, cs))
+            updateTextIndex();
+            bool contains = false;
+            while (!contains)
             {
                 nxtIndx = model_->adjacentIndex (nxtIndx, !backwardSearch);
                 if (!nxtIndx.isValid())
@@ -402,17 +590,10 @@ void FN::find()
                     else
                         nxtIndx = model_->index (model_->rowCount() - 1, 0);
                 }
-                DomItem *item = static_cast<DomItem*>(nxtIndx.internalPointer());
-                if (TextEdit *thisTextEdit = widgets_.value (item))
-                    text = thisTextEdit->toPlainText(); // the node text may have been edited
-                else
-                {
-                    QDomNodeList list = item->node().childNodes();
-                    text = list.item (0).nodeValue();
-                }
+                contains = nodeContains (static_cast<DomItem*>(nxtIndx.internalPointer()), txt, cs);
                 if (nxtIndx == ui->treeView->currentIndex())
                 { // the current index is reached again; stop the search
-                    if (!text.contains (txt, cs))
+                    if (!contains)
                         nxtIndx = QModelIndex();
                     break;
                 }
@@ -431,16 +612,16 @@ void FN::find()
     hlight();
     connect (textEdit->verticalScrollBar(), &QAbstractSlider::valueChanged, this, &FN::scrolled);
     connect (textEdit->horizontalScrollBar(), &QAbstractSlider::valueChanged, this, &FN::scrolled);
-    connect (textEdit, &TextEdit::resized, this, &FN::hlight);
-    connect (textEdit, &QTextEdit::textChanged, this, &FN::hlight);
+    connect (textEdit, &TextEdit::resized, this, &FN::scheduleHlight);
+    connect (textEdit, &QTextEdit::textChanged, this, &FN::scheduleHlight);
 
     if (nxtIndx.isValid())
     {
         searchingOtherNode_ = true;
         ui->treeView->setCurrentIndex (nxtIndx); // selChanged() is called immediately
-        textEdit = qobject_cast< TextEdit *>(ui->stackedWidget->currentWidget());
+        endPreview();
         ui->lineEdit->setText (txt);
-        searchEntries_[textEdit] = txt;
+        currentSession()->searchEntry = txt;
         find();
     }
 }
@@ -451,52 +632,71 @@ void FN::hlight() const
     QWidget *cw = ui->stackedWidget->currentWidget();
     if (!cw) return;
 
-    TextEdit *textEdit = qobject_cast< TextEdit *>(cw);
-    const QString txt = searchEntries_[textEdit];
+    const NodeSession *session = currentSession();
+    if (!session) return;
+    TextEdit *textEdit = session->editor;
+    const QString txt = session->searchEntry;
     if (txt.isEmpty()) return;
 
+    /* find all matches only if the text, the search string or the flags have changed */
+    QTextDocument *doc = textEdit->document();
+    NodeSession::MatchCache &cache = session->matchCache;
+    if (cache.text != txt || cache.flags != searchFlags_ || cache.revision != doc->revision())
+    {
+        cache.revision = doc->revision();
+        cache.text = txt;
+        cache.flags = searchFlags_;
+        cache.matches.clear();
+        /* there is a character for each position of the document in its plain text,
+           where block separators are converted to '\n' and NBSPs to spaces */
+        const QString str = doc->toPlainText();
+        const Qt::CaseSensitivity cs = searchFlags_.testFlag (QTextDocument::FindCaseSensitively)
+                                       ? Qt::CaseSensitive : Qt::CaseInsensitive;
+        const bool wholeWords = searchFlags_.testFlag (QTextDocument::FindWholeWords);
+        int from = 0, idx;
+        while ((idx = str.indexOf (txt, from, cs)) != -1)
+        {
+            const int end = idx + txt.length();
+            if (wholeWords
+                && ((idx != 0 && str.at (idx - 1).isLetterOrNumber())
+                    || (end != str.length() && str.at (end).isLetterOrNumber())))
+            {
+                from = idx + 1;
+                continue;
+            }
+            cache.matches.append (qMakePair (idx, end));
+            from = end;
+        }
+    }
+
     QList<QTextEdit::ExtraSelection> extraSelections;
     /* prepend green highlights */
-    extraSelections.append (greenSels_[textEdit]);
-    QColor yellow = QColor (Qt::yellow);
-    QColor black = QColor (Qt::black);
-    QTextCursor found;
-    /* first put a start cursor at the top left edge... */
-    QPoint Point (0, 0);
-    QTextCursor start = textEdit->cursorForPosition (Point);
-    /* ... then move it backward by the search text length */
-    int startPos = start.position() - txt.length();
-    if (startPos >= 0)
-        start.setPosition (startPos);
-    else
-        start.setPosition (0);
-    int w = textEdit->geometry().width();
-    int h = textEdit->geometry().height();
-    /* get the visible text to check if
-       the search string is inside it */
-    Point = QPoint (w, h);
-    QTextCursor end = textEdit->cursorForPosition (Point);
-    int endPos = end.position() + txt.length();
-    end.movePosition (QTextCursor::End);
-    if (endPos <= end.position())
-        end.setPosition (endPos);
-    QTextCursor visCur = start;
-    visCur.setPosition (end.position(), QTextCursor::KeepAnchor);
-    const QString str = visCur.selection().toPlainText(); // '\n' is included in this way
-    Qt::CaseSensitivity cs = ui->caseButton->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive;
-    if (str.contains (txt, cs)) // don't waste time if the searched text isn't visible
+    extraSelections.append (session->greenSels);
+    if (!cache.matches.isEmpty())
     {
-        while (!(found = finding (txt, start, searchFlags_)).isNull())
+        /* take the matches that are in the visible part of the text */
+        const int startPos = textEdit->cursorForPosition (QPoint (0, 0)).position();
+        const int endPos = textEdit->cursorForPosition (QPoint (textEdit->geometry().width(),
+                                                                textEdit->geometry().height()))
+                           .position() + txt.length();
+        auto it = std::lower_bound (cache.matches.constBegin(), cache.matches.constEnd(), startPos,
+                                    [] (const QPair<int, int> &match, int pos) {
+            return match.second <= pos;
+        });
+        QColor yellow = QColor (Qt::yellow);
+        QColor black = QColor (Qt::black);
+        QTextCursor cur (doc);
+        for (; it != cache.matches.constEnd() && it->first <= endPos; ++it)
         {
             QTextEdit::ExtraSelection extra;
             extra.format.setBackground (yellow);
             extra.format.setFontUnderline (true);
             extra.format.setUnderlineStyle (QTextCharFormat::WaveUnderline);
             extra.format.setUnderlineColor (black);
-            extra.cursor = found;
+            cur.setPosition (it->first);
+            cur.setPosition (it->second, QTextCursor::KeepAnchor);
+            extra.cursor = cur;
             extraSelections.append (extra);
-            start.setPosition (found.position());
-            if (textEdit->cursorRect (start).top() >= h) break;
         }
     }
 
@@ -505,7 +705,8 @@ void FN::hlight() const
 /*************************/
 void FN::rehighlight (TextEdit *textEdit)
 {
-    if (!searchEntries_[textEdit].isEmpty())
+    const NodeSession *session = currentSession();
+    if (session && session->editor == textEdit && !session->searchEntry.isEmpty())
         hlight();
 }
 /*************************/
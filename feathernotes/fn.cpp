@@ -21,6 +21,16 @@
 #include "dommodel.h"
 #include "spinbox.h"
 #include "simplecrypt.h"
+#include "fnxcipher.h"
+#include "fnxreader.h"
+#include "fnxwriter.h"
+#include "fnbfile.h"
+#include "dirnotebook.h"
+#ifdef HAS_SQLITE
+#include "sqlitenotebook.h"
+#endif
+#include "journal.h"
+#include "atomicfile.h"
 #include "settings.h"
 #include "help.h"
 #include "filedialog.h"
@@ -47,6 +57,13 @@
 #include <QTextDocumentWriter>
 #include <QClipboard>
 #include <QMimeDatabase>
+#include <QProgressDialog>
+#include <QBuffer>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QPointer>
+#include <QtConcurrentRun>
+#include <QtConcurrentMap>
 
 #ifdef HAS_X11
 #if defined Q_WS_X11 || defined Q_OS_LINUX || defined Q_OS_OPENBSD || defined Q_OS_NETBSD || defined Q_OS_HURD
@@ -59,8 +76,19 @@ namespace FeatherNotes {
 
 static QSize TOOLBAR_ICON_SIZE;
 
-// Regex of an embedded image (should be checked for the image):
-static const QRegularExpression EMBEDDED_IMG (R"(<\s*img(?=\s)[^<>]*(?<=\s)src\s*=\s*"data:[^<>]*;base64\s*,[a-zA-Z0-9+=/\s]+"[^<>]*/*>)");
+// Regex of an embedded image or an image of the document's store (should be checked for the image):
+static const QRegularExpression EMBEDDED_IMG (R"(<\s*img(?=\s)[^<>]*(?<=\s)src\s*=\s*"(data:[^<>]*;base64\s*,[a-zA-Z0-9+=/\s]+|fnimg:[0-9a-f]+)"[^<>]*/*>)");
+
+// The data of an image from the value of its "src" attribute.
+static QByteArray imageSourceData (const QString &src, const ImageStore &store)
+{
+    const QString id = ImageStore::idOf (QUrl (src));
+    if (!id.isEmpty())
+        return store.data (id);
+    QString str (src);
+    str.remove (QRegularExpression (R"(^data:[^<>]*;base64\s*,)"));
+    return QByteArray::fromBase64 (str.toUtf8());
+}
 
 FN::FN (const QStringList& message, QWidget *parent) : QMainWindow (parent), ui (new Ui::FN)
 {
@@ -88,9 +116,19 @@ FN::FN (const QStringList& message, QWidget *parent) : QMainWindow (parent), ui
        a file is opened, or it is enabled in Preferences. It saves the doc
        only if it belongs to an existing file that needs saving. */
     autoSave_ = -1;
+    editorLimit_ = 100;
+    closedWidgets_ = 0;
+    currentNode_ = nullptr;
     saveNeeded_ = 0;
+    structureModified_ = false;
     timer_ = new QTimer (this);
     connect (timer_, &QTimer::timeout, this, &FN::autoSaving);
+    autoSavePending_ = false;
+    autoSaver_ = new QFutureWatcher<bool> (this);
+    connect (autoSaver_, &QFutureWatcherBase::finished, this, &FN::autoSaved);
+    findAllWatcher_ = new QFutureWatcher<QVector<FindAllMatch> > (this);
+    connect (findAllWatcher_, &QFutureWatcherBase::resultReadyAt, this, &FN::findAllResultReady);
+    connect (findAllWatcher_, &QFutureWatcherBase::finished, this, &FN::findAllFinished);
 
     /* appearance */
     setAttribute (Qt::WA_AlwaysShowToolTips);
@@ -106,15 +144,31 @@ FN::FN (const QStringList& message, QWidget *parent) : QMainWindow (parent), ui
     ui->prevButton->setVisible (false);
     ui->caseButton->setVisible (false);
     ui->wholeButton->setVisible (false);
+    ui->regexButton->setVisible (false);
+    ui->fuzzyButton->setVisible (false);
     ui->everywhereButton->setVisible (false);
     ui->tagsButton->setVisible (false);
     ui->namesButton->setVisible (false);
     searchingOtherNode_ = false;
+    hlightTimer_ = new QTimer (this);
+    hlightTimer_->setSingleShot (true);
+    hlightTimer_->setInterval (16);
+    connect (hlightTimer_, &QTimer::timeout, this, &FN::hlight);
+    prefetchTimer_ = new QTimer (this);
+    prefetchTimer_->setSingleShot (true);
+    prefetchTimer_->setInterval (300);
+    connect (prefetchTimer_, &QTimer::timeout, this, &FN::prefetchDocs);
+    prefetching_ = false;
+    previewEdit_ = nullptr;
+    editorTimer_ = new QTimer (this);
+    editorTimer_->setSingleShot (true);
+    editorTimer_->setInterval (250);
+    connect (editorTimer_, &QTimer::timeout, this, &FN::endPreview);
     rplOtherNode_ = false;
-    replCount_ = 0;
 
-    /* replace dock */
+    /* replace and "Find All" docks */
     ui->dockReplace->setVisible (false);
+    ui->dockFindAll->setVisible (false);
 
     model_ = new DomModel (QDomDocument(), this);
     ui->treeView->setModel (model_);
@@ -217,6 +271,12 @@ FN::FN (const QStringList& message, QWidget *parent) : QMainWindow (parent), ui
 
     /* signal connections */
 
+    /* the editor of a previewed node is made before any action is
+       done because actions may need it (see previewNode()) */
+    const QList<QAction*> allActions = findChildren<QAction*>();
+    for (QAction *action : allActions)
+        connect (action, &QAction::triggered, this, &FN::endPreview);
+
     connect (ui->treeView, &QWidget::customContextMenuRequested, this, &FN::showContextMenu);
     connect (ui->treeView, &TreeView::FNDocDropped, this, &FN::openFNDoc);
 
@@ -316,6 +376,12 @@ FN::FN (const QStringList& message, QWidget *parent) : QMainWindow (parent), ui
     connect (ui->everywhereButton, &QAbstractButton::toggled, this, &FN::allBtn);
     connect (ui->tagsButton, &QAbstractButton::toggled, this, &FN::tagsAndNamesBtn);
     connect (ui->namesButton, &QAbstractButton::toggled, this, &FN::tagsAndNamesBtn );
+    connect (ui->regexButton, &QAbstractButton::toggled, this, &FN::patternBtn);
+    connect (ui->fuzzyButton, &QAbstractButton::toggled, this, &FN::patternBtn);
+
+    connect (ui->actionFindAll, &QAction::triggered, this, &FN::findAll);
+    connect (ui->lineEdit, &QLineEdit::textChanged, this, &FN::cancelFindAll);
+    connect (ui->findAllList, &QListWidget::itemActivated, this, &FN::findAllActivated);
 
     connect (ui->actionReplace, &QAction::triggered, this, &FN::replaceDock);
     connect (ui->dockReplace, &QDockWidget::visibilityChanged, this, &FN::closeReplaceDock);
@@ -368,6 +434,8 @@ FN::FN (const QStringList& message, QWidget *parent) : QMainWindow (parent), ui
     QShortcut *zoominPlus = new QShortcut (QKeySequence (Qt::CTRL + Qt::Key_Plus), this);
     QShortcut *zoomout = new QShortcut (QKeySequence (Qt::CTRL + Qt::Key_Minus), this);
     QShortcut *unzoom = new QShortcut (QKeySequence (Qt::CTRL + Qt::Key_0), this);
+    for (QShortcut *shortcut : {zoomin, zoominPlus, zoomout, unzoom})
+        connect (shortcut, &QShortcut::activated, this, &FN::endPreview);
     connect (zoomin, &QShortcut::activated, this, &FN::zoomingIn);
     connect (zoominPlus, &QShortcut::activated, this, &FN::zoomingIn);
     connect (zoomout, &QShortcut::activated, this, &FN::zoomingOut);
@@ -427,6 +495,7 @@ FN::~FN()
     }
     delete tray_; // also deleted at closeEvent() (this is for Ctrl+C in terminal)
     tray_ = nullptr;
+    discardPrefetchedDocs();
     delete ui;
 }
 /*************************/
@@ -529,6 +598,7 @@ void FN::closeEvent (QCloseEvent *event)
     }
     else
     {
+        leaveDocument();
         writeGeometryConfig();
         delete tray_; // otherwise the app won't quit under KDE
         tray_ = nullptr;
@@ -570,7 +640,7 @@ void FN::createTrayIcon()
     else
     {
         QString shownName = QFileInfo (xmlPath_).fileName();
-        if (shownName.endsWith (".fnx"))
+        if (shownName.endsWith (".fnx") || shownName.endsWith (".fnb") || shownName.endsWith (".fnd"))
             shownName.chop (4);
         tray_->setToolTip ("<p style='white-space:pre'>"
                            + shownName
@@ -786,7 +856,8 @@ void FN::newNote()
     e.setAttribute ("name", tr ("New Node"));
     root.appendChild (e);
 
-    showDoc (doc);
+    leaveDocument();
+    showDoc (new DomModel (doc, this));
     xmlPath_ = QString();
     setTitle (xmlPath_);
     /* may be saved later */
@@ -808,7 +879,7 @@ void FN::setTitle (const QString& fname)
     }
 
     QString shownName = fileInfo.fileName();
-    if (shownName.endsWith (".fnx"))
+    if (shownName.endsWith (".fnx") || shownName.endsWith (".fnb") || shownName.endsWith (".fnd"))
         shownName.chop (4);
 
     QString path (fileInfo.dir().path());
@@ -871,6 +942,41 @@ void FN::enableActions (bool enable)
     ui->actionExportHTML->setEnabled (enable);
     ui->actionPassword->setEnabled (enable);
 
+    enableEditorActions (enable);
+
+    ui->actionExpandAll->setEnabled (enable);
+    ui->actionCollapseAll->setEnabled (enable);
+    ui->actionPrepSibling->setEnabled (enable);
+    ui->actionNewSibling->setEnabled (enable);
+    ui->actionNewChild->setEnabled (enable);
+    ui->actionDeleteNode->setEnabled (enable);
+    ui->actionMoveUp->setEnabled (enable);
+    ui->actionMoveDown->setEnabled (enable);
+    ui->actionMoveLeft->setEnabled (enable);
+    ui->actionMoveRight->setEnabled (enable);
+
+    ui->actionTags->setEnabled (enable);
+    ui->actionRenameNode->setEnabled (enable);
+    ui->actionNodeIcon->setEnabled (enable);
+
+    ui->actionDocFont->setEnabled (enable);
+    ui->actionNodeFont->setEnabled (enable);
+    ui->actionWrap->setEnabled (enable);
+    ui->actionIndent->setEnabled (enable);
+
+    ui->actionFind->setEnabled (enable);
+    ui->actionFindAll->setEnabled (enable);
+
+    if (!enable)
+    {
+        ui->actionUndo->setEnabled (false);
+        ui->actionRedo->setEnabled (false);
+    }
+}
+/*************************/
+// The actions that need the editor of the current node (see previewNode()).
+void FN::enableEditorActions (bool enable)
+{
     ui->actionPaste->setEnabled (enable);
     ui->actionPasteHTML->setEnabled (enable);
     ui->actionSelectAll->setEnabled (enable);
@@ -899,37 +1005,10 @@ void FN::enableActions (bool enable)
     ui->actionEmbedImage->setEnabled (enable);
     ui->actionTable->setEnabled (enable);
 
-    ui->actionExpandAll->setEnabled (enable);
-    ui->actionCollapseAll->setEnabled (enable);
-    ui->actionPrepSibling->setEnabled (enable);
-    ui->actionNewSibling->setEnabled (enable);
-    ui->actionNewChild->setEnabled (enable);
-    ui->actionDeleteNode->setEnabled (enable);
-    ui->actionMoveUp->setEnabled (enable);
-    ui->actionMoveDown->setEnabled (enable);
-    ui->actionMoveLeft->setEnabled (enable);
-    ui->actionMoveRight->setEnabled (enable);
-
-    ui->actionTags->setEnabled (enable);
-    ui->actionRenameNode->setEnabled (enable);
-    ui->actionNodeIcon->setEnabled (enable);
-
-    ui->actionDocFont->setEnabled (enable);
-    ui->actionNodeFont->setEnabled (enable);
-    ui->actionWrap->setEnabled (enable);
-    ui->actionIndent->setEnabled (enable);
-
-    ui->actionFind->setEnabled (enable);
     ui->actionReplace->setEnabled (enable);
-
-    if (!enable)
-    {
-        ui->actionUndo->setEnabled (false);
-        ui->actionRedo->setEnabled (false);
-    }
 }
 /*************************/
-void FN::showDoc (QDomDocument &doc)
+void FN::showDoc (DomModel *newModel)
 {
     if (saveNeeded_)
     {
@@ -938,18 +1017,32 @@ void FN::showDoc (QDomDocument &doc)
         setWindowModified (false);
     }
 
+    /* the results of "Find All" belong to the old document */
+    cancelFindAll();
+    findAllWatcher_->waitForFinished();
+    ui->findAllList->clear();
+    findAllNodes_.clear();
+    ui->dockFindAll->setWindowTitle (tr ("Find All"));
+
+    changedTexts_.clear();
+    discardPrefetchedDocs();
+    sessions_.clear();
+    notebook_.clear();
+    currentNode_ = nullptr;
+    recentNodes_.clear();
+    closedWidgets_ = 0;
     while (ui->stackedWidget->count() > 0)
     {
-        widgets_.clear();
-        searchEntries_.clear();
-        greenSels_.clear();
         QWidget *cw = ui->stackedWidget->currentWidget();
         TextEdit *textEdit = qobject_cast< TextEdit *>(cw);
         ui->stackedWidget->removeWidget (cw);
         delete textEdit; textEdit = nullptr;
     }
+    previewEdit_ = nullptr; // deleted above
+    editorTimer_->stop();
+    lastSelChange_.invalidate();
 
-    QDomElement root = doc.firstChildElement ("feathernotes");
+    QDomElement root = newModel->domDocument.firstChildElement ("feathernotes");
     QString fontStr = root.attribute ("txtfont");
     if (!fontStr.isEmpty())
         defaultFont_.fromString (fontStr);
@@ -964,7 +1057,8 @@ void FN::showDoc (QDomDocument &doc)
     else // nodeFont_ may have changed by the user
         nodeFont_ = font();
 
-    DomModel *newModel = new DomModel (doc, this);
+    structureModified_ = false;
+
     QItemSelectionModel *m = ui->treeView->selectionModel();
     ui->treeView->setModel (newModel);
     ui->treeView->setFont (nodeFont_);
@@ -997,31 +1091,199 @@ void FN::showDoc (QDomDocument &doc)
     /* enable widgets */
     if (!ui->actionSaveAs->isEnabled())
         enableActions (true);
+
+    cachePlainTexts();
+}
+/*************************/
+static QPair<QString, bool> htmlToPlainText (const QString &html)
+{
+    bool exact;
+    const QString text = TextIndex::plainText (html, &exact);
+    return qMakePair (text, exact);
+}
+/*************************/
+// Converts the node texts that are in memory to plain texts in other threads, so that
+// searching in them won't need to do it. Lazily loaded texts are converted when needed.
+void FN::cachePlainTexts()
+{
+    QStringList texts;
+    QList<QPersistentModelIndex> nodes;
+    QVector<quint32> generations;
+    QModelIndex indx = model_->index (0, 0);
+    while (indx.isValid())
+    {
+        DomItem *item = static_cast<DomItem*>(indx.internalPointer());
+        if (!item->hasLazyText() && !item->hasPlainText())
+        {
+            texts << item->text();
+            nodes << QPersistentModelIndex (indx);
+            generations << item->textGeneration();
+        }
+        indx = model_->adjacentIndex (indx, true);
+    }
+    if (texts.isEmpty()) return;
+
+    QFutureWatcher<QPair<QString, bool> > *watcher = new QFutureWatcher<QPair<QString, bool> > (this);
+    connect (watcher, &QFutureWatcherBase::resultReadyAt, this, [watcher, nodes, generations] (int i) {
+        const QPersistentModelIndex &node = nodes.at (i);
+        if (!node.isValid()) return; // the node or document is closed
+        const QPair<QString, bool> res = watcher->resultAt (i);
+        static_cast<DomItem*>(node.internalPointer())->setPlainText (generations.at (i), res.first, res.second);
+    });
+    connect (watcher, &QFutureWatcherBase::finished, watcher, &QObject::deleteLater);
+    watcher->setFuture (QtConcurrent::mapped (texts, htmlToPlainText));
 }
 /*************************/
 void FN::fileOpen (const QString &filePath)
 {
     if (!filePath.isEmpty())
     {
+        /* the current file is compacted before it's reopened; other
+           documents are left only when the new one is read */
+        const bool reopening = filePath == xmlPath_;
+        if (reopening)
+            leaveDocument();
+
         QFile file (filePath);
         if (file.open (QIODevice::ReadOnly))
         {
-            QTextStream in (&file);
-            QString cntnt = in.readAll();
-            file.close();
-            SimpleCrypt crypto (Q_UINT64_C(0xc9a25eb1610eb104));
-            QString decrypted = crypto.decryptToString (cntnt);
-            if (decrypted.isEmpty())
-                decrypted = cntnt;
+            /* the progress is shown only if opening takes time */
+            QProgressDialog progress (tr ("Opening..."), QString(), 0, 100, this);
+            progress.setWindowModality (Qt::WindowModal);
+            progress.setMinimumDuration (500);
+            progress.setCancelButton (nullptr);
+            FnxReader reader;
+            connect (&reader, &FnxReader::progress, &progress, &QProgressDialog::setValue);
+            FnbReader fnbReader;
+            QSharedPointer<Notebook> notebook;
+
             QDomDocument document;
-            if (document.setContent (decrypted))
+            QSharedPointer<TextSource> source;
+            QVector<TextRange> ranges;
+            QByteArray decrypted;
+            bool authenticated = false;
+            bool ok = false;
+            if (DirNotebook::isNotebookPath (filePath))
+                notebook = QSharedPointer<Notebook> (new DirNotebook (filePath));
+#ifdef HAS_SQLITE
+            else if (SqliteNotebook::isSqlite (&file))
+                notebook = QSharedPointer<Notebook> (new SqliteNotebook (filePath));
+#endif
+            if (notebook)
+            { // only the nodes are read; texts are left in the notebook
+                file.close();
+                ok = notebook->read (document, ranges);
+                if (ok)
+                    source = notebook;
+            }
+            else if (FnbReader::isFnb (&file))
+            { // only the node table is read; texts are left in the mapped file
+                file.close();
+                ok = fnbReader.read (filePath, document, source, ranges);
+            }
+            else if (FnxReader::isXml (&file))
+            {
+                if (lazyLoading_)
+                { // leave node texts in the mapped file
+                    file.close();
+                    ok = reader.readMapped (filePath, document, source, ranges);
+                    if (!ok)
+                        file.open (QIODevice::ReadOnly);
+                }
+                if (!ok)
+                { // stream the XML file directly into the DOM tree
+                    ok = reader.read (&file, document);
+                    file.close();
+                }
+            }
+            else if (FnxCipher::isEncrypted (&file))
+            { // the password is needed for decrypting
+                encrypted_ = file.readAll();
+                file.close();
+                if (isPswrdCorrect())
+                {
+                    decrypted.swap (decrypted_);
+                    authenticated = true;
+                }
+                encrypted_ = QByteArray();
+                decrypted_ = QByteArray();
+            }
+            else
+            { // the old format
+                {
+                    SimpleCrypt crypto (Q_UINT64_C(0xc9a25eb1610eb104));
+                    decrypted = crypto.decryptBase64ToByteArray (file.readAll());
+                }
+                file.close();
+            }
+            if (FnbReader::isFnb (decrypted))
+                ok = fnbReader.read (decrypted, document, source, ranges);
+            else if (!decrypted.isEmpty())
+            {
+                QBuffer buffer (&decrypted);
+                if (buffer.open (QIODevice::ReadOnly))
+                    ok = reader.read (&buffer, document);
+            }
+            progress.close();
+
+            if (ok)
             {
                 QDomElement root = document.firstChildElement ("feathernotes");
                 if (root.isNull()) return;
-                pswrd_ = root.attribute ("pswrd");
-                if (!pswrd_.isEmpty() && !isPswrdCorrect())
-                    return;
-                showDoc (document);
+                /* the password and cipher of the current document
+                   are kept until it's left below */
+                QString pswrd;
+                FnxCipher cipher;
+                if (authenticated)
+                {
+                    cipher = openedCipher_;
+                    pswrd = cipher.password();
+                }
+                else
+                {
+                    pswrd = root.attribute ("pswrd");
+                    if (!pswrd.isEmpty())
+                    {
+                        const QString curPswrd = pswrd_;
+                        pswrd_ = pswrd; // isPswrdCorrect() checks it
+                        const bool correct = isPswrdCorrect();
+                        pswrd_ = curPswrd;
+                        if (!correct) return;
+                    }
+                }
+                DomModel *newModel = new DomModel (document, this);
+                if (source)
+                    newModel->setTextSource (source, ranges);
+                /* apply the node texts that were saved incrementally */
+                QList<JournalRecord> records;
+                if (pswrd.isEmpty() && Journal::read (filePath, records))
+                    Journal::apply (newModel->rootItem(), records);
+                else
+                {
+                    /* a journal that doesn't belong to the file is removed,
+                       so that the next records aren't appended to it */
+                    if (pswrd.isEmpty())
+                        Journal::remove (filePath);
+                    if (indexCache_ && pswrd.isEmpty() && !notebook)
+                        newModel->textIndex.load (filePath, Journal::fingerprint (filePath), newModel->rootItem());
+                }
+                if (notebook)
+                {
+                    notebook->setItems (newModel->rootItem());
+#ifdef HAS_SQLITE
+                    if (QSharedPointer<SqliteNotebook> db = notebook.dynamicCast<SqliteNotebook>())
+                    { // only the texts that are edited here will be indexed by TextIndex
+                        newModel->textIndex.setFullTextSearch (db);
+                        newModel->textIndex.setBuilt (true);
+                    }
+#endif
+                }
+                if (!reopening)
+                    leaveDocument();
+                cipher_ = cipher;
+                pswrd_ = pswrd;
+                showDoc (newModel);
+                notebook_ = notebook;
                 xmlPath_ = filePath;
                 setTitle (xmlPath_);
                 docProp();
@@ -1113,7 +1375,11 @@ void FN::openFile()
     dialog.setAcceptMode (QFileDialog::AcceptOpen);
     dialog.setWindowTitle (tr ("Open file..."));
     dialog.setFileMode (QFileDialog::ExistingFiles);
-    dialog.setNameFilter (tr ("FeatherNotes documents (*.fnx);;All Files (*)"));
+#ifdef HAS_SQLITE
+    dialog.setNameFilter (tr ("FeatherNotes documents (*.fnx *.fnb *.fnd *.fndb);;All Files (*)"));
+#else
+    dialog.setNameFilter (tr ("FeatherNotes documents (*.fnx *.fnb *.fnd);;All Files (*)"));
+#endif
     if (QFileInfo (path).isDir())
         dialog.setDirectory (path);
     else
@@ -1171,7 +1437,8 @@ void FN::dragMoveEvent (QDragMoveEvent *event)
         const auto urls = event->mimeData()->urls();
         for (const QUrl &url : urls)
         {
-            if (url.fileName().endsWith (".fnx"))
+            if (url.fileName().endsWith (".fnx") || url.fileName().endsWith (".fnb")
+                || url.fileName().endsWith (".fnd"))
             {
                 event->acceptProposedAction();
                 return;
@@ -1195,7 +1462,8 @@ void FN::dragEnterEvent (QDragEnterEvent *event)
         const auto urls = event->mimeData()->urls();
         for (const QUrl &url : urls)
         {
-            if (url.fileName().endsWith (".fnx"))
+            if (url.fileName().endsWith (".fnx") || url.fileName().endsWith (".fnb")
+                || url.fileName().endsWith (".fnd"))
             {
                 event->acceptProposedAction();
                 return;
@@ -1219,7 +1487,8 @@ void FN::dropEvent (QDropEvent *event)
         const auto urls = event->mimeData()->urls();
         for (const QUrl &url : urls)
         {
-            if (url.fileName().endsWith (".fnx"))
+            if (url.fileName().endsWith (".fnx") || url.fileName().endsWith (".fnb")
+                || url.fileName().endsWith (".fnd"))
             {
                 openFNDoc (url.path());
                 break;
@@ -1237,6 +1506,44 @@ void FN::dropEvent (QDropEvent *event)
     event->acceptProposedAction();
 }
 /*************************/
+// The binary format is used for files with the ".fnb" extension.
+static bool writeSnapshot (const FnxSnapshot &snapshot, const QString &filePath, QIODevice *device)
+{
+    if (filePath.endsWith (".fnb"))
+        return FnbWriter::write (snapshot, device);
+    return FnxWriter::write (snapshot, device);
+}
+/*************************/
+// Writes a document snapshot in a way that is safe to be called in any thread.
+// The file isn't truncated because lazily loaded node texts may be read from it.
+static bool saveSnapshot (const FnxSnapshot &snapshot, const QString &filePath,
+                          const FnxCipher *cipher, bool sync)
+{
+    AtomicFile outputFile (filePath, sync);
+    if (!outputFile.open())
+        return false;
+
+    bool ok = false;
+    if (cipher == nullptr)
+        ok = writeSnapshot (snapshot, filePath, outputFile.device());
+    else
+    {
+        QBuffer buffer;
+        if (buffer.open (QIODevice::WriteOnly) && writeSnapshot (snapshot, filePath, &buffer))
+        {
+            buffer.close();
+            const QByteArray encrypted = cipher->encrypt (buffer.data());
+            ok = (!encrypted.isEmpty()
+                  && outputFile.device()->write (encrypted) == encrypted.size());
+        }
+    }
+    if (!ok || !outputFile.commit())
+        return false;
+    /* the journal is included in the file now */
+    Journal::remove (filePath);
+    return true;
+}
+/*************************/
 void FN::autoSaving()
 {
     if (xmlPath_.isEmpty() || saveNeeded_ == 0
@@ -1244,7 +1551,40 @@ void FN::autoSaving()
     {
         return;
     }
-    fileSave (xmlPath_);
+    if (autoSaver_->isRunning()) return; // the next time
+
+    if (notebook_ && notebook_->filePath() == xmlPath_)
+    { // only the changes are written
+        fileSave (xmlPath_);
+        return;
+    }
+    if (canJournal())
+    { // appending to the journal is fast
+        fileSave (xmlPath_);
+        return;
+    }
+
+#ifndef Q_OS_UNIX
+    model_->detachTexts();
+#endif
+    /* only get the HTML texts and take a snapshot of the document here;
+       serializing, encrypting and writing are done in another thread */
+    setNodesTexts();
+    const FnxSnapshot snapshot = FnxWriter::snapshot (model_);
+    const QString filePath = xmlPath_;
+    const bool encrypt = !pswrd_.isEmpty();
+    if (encrypt)
+    {
+        cipher_.setPassword (pswrd_);
+        cipher_.setCompressionLevel (compressionLevel_);
+    }
+    const FnxCipher cipher = cipher_;
+    const bool sync = syncPolicy_ == SyncOnSave;
+    markSaved();
+    autoSavePending_ = true;
+    autoSaver_->setFuture (QtConcurrent::run ([snapshot, filePath, encrypt, cipher, sync] () {
+        return saveSnapshot (snapshot, filePath, encrypt ? &cipher : nullptr, sync);
+    }));
 }
 /*************************/
 void FN::notSaved()
@@ -1258,7 +1598,7 @@ void FN::notSaved()
     msgBox.exec();
 }
 /*************************/
-void FN::setNodesTexts()
+QList<DomItem*> FN::setNodesTexts()
 {
     /* first set the default font */
     QDomElement root = model_->domDocument.firstChildElement ("feathernotes");
@@ -1269,49 +1609,38 @@ void FN::setNodesTexts()
     else
         root.removeAttribute ("pswrd");
 
-    QHash<DomItem*, TextEdit*>::iterator it;
-    for (it = widgets_.begin(); it != widgets_.end(); ++it)
+    QList<DomItem*> changed;
+    QHash<DomItem*, NodeSession>::iterator it;
+    for (it = sessions_.begin(); it != sessions_.end(); ++it)
     {
-        if (!it.value()->document()->isModified())
+        TextEdit *textEdit = it.value().editor;
+        if (!textEdit || !textEdit->document()->isModified())
             continue;
 
         QString txt;
         /* don't write useless HTML code */
-        if (!it.value()->toPlainText().isEmpty())
+        if (!textEdit->toPlainText().isEmpty())
         {
             /* unzoom the text if it's zoomed */
-            if (it.value()->document()->defaultFont() != defaultFont_)
+            if (textEdit->document()->defaultFont() != defaultFont_)
             {
-                QTextDocument *tempDoc = it.value()->document()->clone();
+                QTextDocument *tempDoc = textEdit->document()->clone();
                 tempDoc->setDefaultFont (defaultFont_);
                 txt = tempDoc->toHtml();
                 delete tempDoc;
             }
             else
-                txt = it.value()->toHtml();
+                txt = textEdit->toHtml();
         }
-        DomItem *item = it.key();
-        QDomNodeList list = item->node().childNodes();
-
-        if (list.isEmpty())
-        {
-            /* if this node doesn't have any child,
-               append a text child node to it... */
-            QDomText t = model_->domDocument.createTextNode (txt);
-            item->node().appendChild (t);
-        }
-        else if (list.item (0).isElement())
-        {
-            /* ... but if its first child is an element node,
-               insert the text node before that node... */
-            QDomText t = model_->domDocument.createTextNode (txt);
-            item->node().insertBefore (t, list.item (0));
-        }
-        else if (list.item (0).isText())
-            /* ... finally, if this node's first child
-               is a text node, replace its text */
-            list.item (0).setNodeValue (txt);
+        it.key()->setText (txt);
+        changed << it.key();
+    }
+    for (DomItem *item : changedTexts_)
+    {
+        if (!editorOf (item)) // otherwise, its text is set above
+            changed << item;
     }
+    return changed;
 }
 /*************************/
 bool FN::saveFile()
@@ -1344,7 +1673,11 @@ bool FN::saveFile()
             dialog.setAcceptMode (QFileDialog::AcceptSave);
             dialog.setWindowTitle (tr ("Save As..."));
             dialog.setFileMode (QFileDialog::AnyFile);
-            dialog.setNameFilter (tr ("FeatherNotes documents (*.fnx);;All Files (*)"));
+#ifdef HAS_SQLITE
+            dialog.setNameFilter (tr ("FeatherNotes documents (*.fnx);;Binary FeatherNotes documents (*.fnb);;FeatherNotes notebooks (*.fnd *.fndb);;All Files (*)"));
+#else
+            dialog.setNameFilter (tr ("FeatherNotes documents (*.fnx);;Binary FeatherNotes documents (*.fnb);;FeatherNotes notebooks (*.fnd);;All Files (*)"));
+#endif
             dialog.setDirectory (fname.section ("/", 0, -2)); // workaround for KDE
             dialog.selectFile (fname);
             dialog.autoScroll();
@@ -1365,7 +1698,11 @@ bool FN::saveFile()
         dialog.setAcceptMode (QFileDialog::AcceptSave);
         dialog.setWindowTitle (tr ("Save As..."));
         dialog.setFileMode (QFileDialog::AnyFile);
-        dialog.setNameFilter (tr ("FeatherNotes documents (*.fnx);;All Files (*)"));
+#ifdef HAS_SQLITE
+        dialog.setNameFilter (tr ("FeatherNotes documents (*.fnx);;Binary FeatherNotes documents (*.fnb);;FeatherNotes notebooks (*.fnd *.fndb);;All Files (*)"));
+#else
+        dialog.setNameFilter (tr ("FeatherNotes documents (*.fnx);;Binary FeatherNotes documents (*.fnb);;FeatherNotes notebooks (*.fnd);;All Files (*)"));
+#endif
         dialog.setDirectory (fname.section ("/", 0, -2)); // workaround for KDE
         dialog.selectFile (fname);
         dialog.autoScroll();
@@ -1388,64 +1725,246 @@ bool FN::saveFile()
     return true;
 }
 /*************************/
-bool FN::fileSave (const QString &filePath)
+// Notebooks are recognized by the extensions of their files on saving.
+static bool isNotebookPath (const QString &filePath)
+{
+#ifdef HAS_SQLITE
+    if (SqliteNotebook::isNotebookPath (filePath))
+        return true;
+#endif
+    return DirNotebook::isNotebookPath (filePath);
+}
+/*************************/
+bool FN::fileSave (const QString &filePath, bool full)
 {
-    QFile outputFile (filePath);
-    if (pswrd_.isEmpty())
+    /* an auto-saving shouldn't overwrite this saving later */
+    waitForAutoSave();
+
+    if (isNotebookPath (filePath))
+        return saveNotebook (filePath);
+
+    /* if only node texts are changed, append them to the journal
+       of the file instead of rewriting it (encrypted files are
+       always rewritten because the journal isn't encrypted) */
+    if (!full && canJournal() && filePath == xmlPath_ && QFile::exists (filePath))
     {
-        if (outputFile.open (QIODevice::WriteOnly))
+        const QList<DomItem*> changed = setNodesTexts();
+        QList<JournalRecord> records;
+        for (DomItem *item : changed)
         {
-            /* now, it's the time to set the nodes' texts */
-            setNodesTexts();
-
-            QTextStream outStream (&outputFile);
-            model_->domDocument.save (outStream, 1);
-            outputFile.close();
-
-            xmlPath_ = filePath;
-            setTitle (xmlPath_);
-            QHash<DomItem*, TextEdit*>::iterator it;
-            for (it = widgets_.begin(); it != widgets_.end(); ++it)
-                it.value()->document()->setModified (false);
-            if (saveNeeded_)
-            {
-                saveNeeded_ = 0;
-                ui->actionSave->setEnabled (false);
-                setWindowModified (false);
-            }
-            docProp();
+            JournalRecord record;
+            record.path = Journal::itemPath (item);
+            record.text = item->text();
+            records << record;
+        }
+        if (records.isEmpty() || Journal::append (filePath, records, syncPolicy_ == SyncOnSave))
+        {
+            markSaved();
+            return true;
         }
-        else return false;
+        /* if the journal can't be written, save the whole file */
+    }
+
+#ifndef Q_OS_UNIX
+    /* a mapped file can't be replaced here */
+    model_->detachTexts();
+#endif
+    /* now, it's the time to set the nodes' texts */
+    setNodesTexts();
+    if (!pswrd_.isEmpty())
+    {
+        cipher_.setPassword (pswrd_); // the keys are derived only once
+        cipher_.setCompressionLevel (compressionLevel_);
+    }
+    if (!saveSnapshot (FnxWriter::snapshot (model_), filePath,
+                       pswrd_.isEmpty() ? nullptr : &cipher_, syncPolicy_ == SyncOnSave))
+        return false;
+
+    if (notebook_)
+    { // the document isn't a notebook anymore
+        notebook_.clear();
+        model_->textIndex.setFullTextSearch (QSharedPointer<FullTextSearch>());
+        model_->textIndex.clear();
+    }
+
+    xmlPath_ = filePath;
+    setTitle (xmlPath_);
+    markSaved();
+    docProp();
+
+    return true;
+}
+/*************************/
+// Only the changed node texts are written if the notebook is the current file
+// and its structure isn't changed. Notebooks can't be encrypted.
+bool FN::saveNotebook (const QString &filePath)
+{
+    if (!pswrd_.isEmpty()) return false;
+
+    const QList<DomItem*> changed = setNodesTexts();
+    bool ok = false;
+    if (notebook_ && notebook_->filePath() == filePath)
+    {
+        if (!structureModified_ && !model_->imageStore.hasUnsavedImages())
+            ok = notebook_->saveTexts (changed);
+        if (!ok)
+            ok = notebook_->saveAll (model_);
+    }
+    else
+    { // a new notebook replaces the file
+        if (QFile::exists (filePath) && !QFile::remove (filePath))
+            return false;
+        QSharedPointer<Notebook> notebook;
+        if (DirNotebook::isNotebookPath (filePath))
+            notebook = QSharedPointer<Notebook> (new DirNotebook (filePath));
+#ifdef HAS_SQLITE
+        else
+            notebook = QSharedPointer<Notebook> (new SqliteNotebook (filePath));
+#endif
+        ok = notebook->saveAll (model_);
+        if (ok)
+            notebook_ = notebook;
+    }
+    if (!ok) return false;
+#ifdef HAS_SQLITE
+    if (QSharedPointer<SqliteNotebook> db = notebook_.dynamicCast<SqliteNotebook>())
+    { // also, the cached candidates of the search may be outdated
+        model_->textIndex.setFullTextSearch (db);
+        model_->textIndex.setBuilt (true);
+    }
+#endif
+
+    xmlPath_ = filePath;
+    setTitle (xmlPath_);
+    markSaved();
+    docProp();
+    return true;
+}
+/*************************/
+// Changes other than those of node texts, including new images, need a full saving.
+bool FN::canJournal() const
+{
+    return journal_ && !structureModified_ && pswrd_.isEmpty()
+           && !model_->imageStore.hasUnsavedImages();
+}
+/*************************/
+void FN::markSaved()
+{
+    structureModified_ = false;
+    changedTexts_.clear();
+    model_->imageStore.setSaved();
+    QHash<DomItem*, NodeSession>::iterator it;
+    for (it = sessions_.begin(); it != sessions_.end(); ++it)
+    {
+        if (it.value().editor)
+            it.value().editor->document()->setModified (false);
+    }
+    if (saveNeeded_)
+    {
+        saveNeeded_ = 0;
+        ui->actionSave->setEnabled (false);
+        setWindowModified (false);
+    }
+}
+/*************************/
+void FN::waitForAutoSave()
+{
+    if (autoSaver_->isRunning())
+        autoSaver_->waitForFinished();
+    autoSaved();
+}
+/*************************/
+void FN::autoSaved()
+{
+    if (!autoSavePending_) return;
+    autoSavePending_ = false;
+    if (!autoSaver_->result())
+    { // the texts are in the DOM tree and will be saved with the next saving
+        noteModified();
+    }
+}
+/*************************/
+// Merges the journal of the current file into it when the document is left.
+void FN::compactJournal()
+{
+    waitForAutoSave();
+
+    if (xmlPath_.isEmpty() || !Journal::exists (xmlPath_))
+        return;
+
+    if (saveNeeded_ == 0)
+    { // the document is the same as the file with its journal
+        fileSave (xmlPath_, true);
+        return;
+    }
+
+    /* unsaved changes may have been discarded; so, the
+       journal should be merged into the file directly */
+    QList<JournalRecord> records;
+    if (!Journal::read (xmlPath_, records))
+    { // the journal doesn't belong to the file
+        Journal::remove (xmlPath_);
+        return;
+    }
+    QFile file (xmlPath_);
+    if (!file.open (QIODevice::ReadOnly))
+        return;
+    QDomDocument document;
+    QSharedPointer<TextSource> source;
+    QVector<TextRange> ranges;
+    bool ok = false;
+    if (FnbReader::isFnb (&file))
+    {
+        file.close();
+        FnbReader fnbReader;
+        ok = fnbReader.read (xmlPath_, document, source, ranges);
     }
     else
     {
-        if (outputFile.open (QFile::WriteOnly))
+        FnxReader reader;
+        ok = FnxReader::isXml (&file) && reader.read (&file, document);
+        file.close();
+    }
+    if (!ok) return;
+
+#ifndef Q_OS_UNIX
+    model_->detachTexts();
+#endif
+    DomModel tmpModel (document);
+    if (source)
+    {
+        tmpModel.setTextSource (source, ranges);
+#ifndef Q_OS_UNIX
+        tmpModel.detachTexts();
+#endif
+    }
+    Journal::apply (tmpModel.rootItem(), records);
+    saveSnapshot (FnxWriter::snapshot (&tmpModel), xmlPath_, nullptr, false);
+}
+/*************************/
+void FN::leaveDocument()
+{
+    compactJournal();
+
+    /* the search index is cached only if it matches the saved document */
+    if (!xmlPath_.isEmpty() && QFile::exists (xmlPath_))
+    {
+        if (!pswrd_.isEmpty())
+            QFile::remove (TextIndex::cachePath (xmlPath_));
+        else if (indexCache_ && saveNeeded_ == 0 && !notebook_ // node files aren't in the fingerprint
+                 && model_->textIndex.isBuilt())
         {
-            setNodesTexts();
-            SimpleCrypt crypto (Q_UINT64_C (0xc9a25eb1610eb104));
-            QString encrypted = crypto.encryptToString (model_->domDocument.toString());
-
-            QTextStream out (&outputFile);
-            out << encrypted;
-            outputFile.close();
-
-            xmlPath_ = filePath;
-            setTitle (xmlPath_);
-            QHash<DomItem*, TextEdit*>::iterator it;
-            for (it = widgets_.begin(); it != widgets_.end(); ++it)
-                it.value()->document()->setModified (false);
-            if (saveNeeded_)
-            {
-                saveNeeded_ = 0;
-                ui->actionSave->setEnabled (false);
-                setWindowModified (false);
-            }
-            docProp();
+            updateTextIndex();
+            model_->textIndex.save (xmlPath_, Journal::fingerprint (xmlPath_));
         }
-        else return false;
     }
 
-    return true;
+    if (syncPolicy_ == SyncOnLeave && !xmlPath_.isEmpty() && QFile::exists (xmlPath_))
+    {
+        AtomicFile::sync (xmlPath_);
+        if (Journal::exists (xmlPath_))
+            AtomicFile::sync (Journal::journalPath (xmlPath_));
+    }
 }
 /*************************/
 void FN::undoing()
@@ -1454,13 +1973,7 @@ void FN::undoing()
     if (!cw) return;
 
     /* remove green highlights */
-    QHash<TextEdit*,QList<QTextEdit::ExtraSelection> >::iterator it;
-    for (it = greenSels_.begin(); it != greenSels_.end(); ++it)
-    {
-        QList<QTextEdit::ExtraSelection> extraSelectionsIth;
-        greenSels_[it.key()] = extraSelectionsIth;
-        it.key()->setExtraSelections (QList<QTextEdit::ExtraSelection>());
-    }
+    removeGreenSels();
 
     qobject_cast< TextEdit *>(cw)->undo();
 }
@@ -1524,10 +2037,18 @@ void FN::selectAllText()
         qobject_cast< TextEdit *>(cw)->selectAll();
 }
 /*************************/
-TextEdit *FN::newWidget()
+// Creates an editor, with the given document if any.
+TextEdit *FN::newWidget (QTextDocument *doc)
 {
     TextEdit *textEdit = new TextEdit;
+    if (doc)
+    {
+        /* the editor should be set up after its document is set */
+        doc->setParent (textEdit);
+        textEdit->setDocument (doc);
+    }
     textEdit->setScrollJumpWorkaround (scrollJumpWorkaround_);
+    textEdit->setImageStore (&model_->imageStore, imageStore_);
     //textEdit->autoIndentation = true; // auto-indentation is enabled by default
     textEdit->autoBracket = autoBracket_;
     textEdit->autoReplace = autoReplace_;
@@ -1729,6 +2250,57 @@ void FN::copyLink()
     clipboard->setText (linkAtPos_);
 }
 /*************************/
+// Removes the style of the body, so that the text can be zoomed.
+static QString withPlainBody (const QString &html)
+{
+    QString text = html;
+    QRegularExpressionMatch match;
+    QRegularExpression regex (R"(^<!DOCTYPE[A-Za-z0-9/<>,;.:\-={}\s"]+</style></head><body\sstyle=[A-Za-z0-9/<>;:\-\s"']+>)");
+    if (text.indexOf (regex, 0, &match) > -1)
+    {
+        QString str = "<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.0//EN\" \"http://www.w3.org/TR/REC-html40/strict.dtd\">\n"
+                      "<html><head><meta name=\"qrichtext\" content=\"1\" /><style type=\"text/css\">\n"
+                      "p, li { white-space: pre-wrap; }\n"
+                      "</style></head><body>";
+        text.replace (0, match.capturedLength(), str);
+    }
+    return text;
+}
+/*************************/
+// Makes the document of a node in another thread before it is shown. The images
+// are decoded here too, so that only the editor will be left to the GUI thread.
+struct DocumentMaker
+{
+    typedef QTextDocument *result_type;
+
+    QFont font;
+    ImageStore store; // a snapshot, whose images are shared implicitly
+
+    result_type operator() (const QString &html) const
+    {
+        QTextDocument *doc = new QTextDocument;
+        doc->setDefaultFont (font);
+        doc->setHtml (withPlainBody (html));
+        doc->setModified (false);
+
+        QSet<QString> sources;
+        QRegularExpressionMatchIterator it = EMBEDDED_IMG.globalMatch (html);
+        while (it.hasNext())
+        {
+            const QString src = it.next().captured (1);
+            if (sources.contains (src)) continue;
+            sources.insert (src);
+            QImage img;
+            if (img.loadFromData (imageSourceData (src, store)))
+                doc->addResource (QTextDocument::ImageResource, QUrl (src), img);
+        }
+
+        /* the document will be given to an editor */
+        doc->moveToThread (QCoreApplication::instance()->thread());
+        return doc;
+    }
+};
+/*************************/
 void FN::selChanged (const QItemSelection &selected, const QItemSelection& /*deselected*/)
 {
     if (selected.isEmpty()) // if the last node is closed
@@ -1751,25 +2323,28 @@ void FN::selChanged (const QItemSelection &selected, const QItemSelection& /*des
 
     if (treeViewDND_) return;
 
+    /* while nodes are passed quickly in the side-pane, as when an arrow key
+       is held down, those without editors are only previewed (see previewNode());
+       nodes that are selected by the code, as in searching, aren't previewed */
+    const bool passing = ui->treeView->hasFocus()
+                         && lastSelChange_.isValid() && lastSelChange_.elapsed() < 150;
+    lastSelChange_.start();
+
     /* if a widget is paired with this DOM item, show it;
        otherwise create a widget and pair it with the item */
     QModelIndex index = selected.indexes().at (0);
-    TextEdit *textEdit = nullptr;
-    bool found = false;
-    QHash<DomItem*, TextEdit*>::iterator it;
-    for (it = widgets_.begin(); it != widgets_.end(); ++it)
-    {
-        if (it.key() == static_cast<DomItem*>(index.internalPointer()))
-        {
-            found = true;
-            break;
-        }
-    }
-    if (found)
+    DomItem *item = static_cast<DomItem*>(index.internalPointer());
+    /* a session is made only when an editor is made, not for a preview */
+    QHash<DomItem*, NodeSession>::iterator it = sessions_.find (item);
+    TextEdit *textEdit = it == sessions_.end() ? nullptr : it.value().editor;
+    currentNode_ = item;
+    editorTimer_->stop();
+    if (textEdit)
     {
-        textEdit = it.value();
         ui->stackedWidget->setCurrentWidget (textEdit);
-        QString txt = searchEntries_[textEdit];
+        recentNodes_.removeOne (item);
+        recentNodes_.append (item);
+        QString txt = it.value().searchEntry;
         /* change the search entry's text only
            if the search isn't done in tags or names */
         if (!ui->tagsButton->isChecked()
@@ -1779,25 +2354,19 @@ void FN::selChanged (const QItemSelection &selected, const QItemSelection& /*des
             if (!txt.isEmpty()) hlight();
         }
     }
+    else if (passing && !recentNodes_.isEmpty())
+    {
+        previewNode (item);
+        return;
+    }
     else
     {
-        QString text;
-        DomItem *item = static_cast<DomItem*>(index.internalPointer());
-        QDomNodeList list = item->node().childNodes();
-        text = list.item (0).nodeValue();
-        /* this is needed for text zooming */
-        QRegularExpressionMatch match;
-        QRegularExpression regex (R"(^<!DOCTYPE[A-Za-z0-9/<>,;.:\-={}\s"]+</style></head><body\sstyle=[A-Za-z0-9/<>;:\-\s"']+>)");
-        if (text.indexOf (regex, 0, &match) > -1)
-        {
-            QString str = "<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.0//EN\" \"http://www.w3.org/TR/REC-html40/strict.dtd\">\n"
-                          "<html><head><meta name=\"qrichtext\" content=\"1\" /><style type=\"text/css\">\n"
-                          "p, li { white-space: pre-wrap; }\n"
-                          "</style></head><body>";
-            text.replace (0, match.capturedLength(), str);
-        }
-        textEdit = newWidget();
-        textEdit->setHtml (text);
+        NodeSession &session = sessions_[item];
+        /* use the prefetched document of the node if it's still valid */
+        QTextDocument *doc = takePrefetchedDoc (item);
+        textEdit = newWidget (doc);
+        if (!doc)
+            textEdit->setHtml (withPlainBody (item->text()));
 
         connect (textEdit->document(), &QTextDocument::modificationChanged, this, &FN::setSaveEnabled);
         connect (textEdit->document(), &QTextDocument::undoAvailable, this, &FN::setUndoEnabled);
@@ -1808,19 +2377,37 @@ void FN::selChanged (const QItemSelection &selected, const QItemSelection& /*des
 
         /* focus the text widget only if
            a document is opened just now */
-        if (widgets_.isEmpty())
+        if (recentNodes_.isEmpty())
             textEdit->setFocus();
 
-        widgets_[static_cast<DomItem*>(index.internalPointer())] = textEdit;
-        searchEntries_[textEdit] = QString();
-        greenSels_[textEdit] = QList<QTextEdit::ExtraSelection>();
+        /* if the editor of this node was closed to save memory,
+           scroll to where it was when its text is laid out */
+        if (session.scrollPos > 0)
+        {
+            const int pos = session.scrollPos;
+            QPointer<TextEdit> edit (textEdit);
+            QTimer::singleShot (0, this, [edit, pos] () {
+                if (edit)
+                    edit->verticalScrollBar()->setValue (pos);
+            });
+        }
+
+        session.editor = textEdit;
+        recentNodes_.append (item);
         if (!ui->tagsButton->isChecked()
             && !ui->namesButton->isChecked())
         {
             ui->lineEdit->setText (QString());
         }
+
+        closeOldWidgets();
     }
 
+    /* the nodes around this one may be shown next */
+    prefetchTimer_->start();
+
+    enableEditorActions (true);
+
     ui->actionUndo->setEnabled (textEdit->document()->isUndoAvailable());
     ui->actionRedo->setEnabled (textEdit->document()->isRedoAvailable());
 
@@ -1835,10 +2422,256 @@ void FN::selChanged (const QItemSelection &selected, const QItemSelection& /*des
     directionChanged();
 }
 /*************************/
+// Shows the plain text of a node in a read-only editor, which is much cheaper
+// than creating the node's editor, and creates the latter when the selection
+// rests. In this way, passing many nodes neither lags nor leaves editors behind.
+void FN::previewNode (DomItem *item)
+{
+    if (!previewEdit_)
+    {
+        previewEdit_ = newWidget();
+        previewEdit_->setReadOnly (true);
+        previewEdit_->setUndoRedoEnabled (false);
+    }
+    else
+        ui->stackedWidget->setCurrentWidget (previewEdit_);
+    previewEdit_->document()->setDefaultFont (defaultFont_);
+    previewEdit_->setPlainText (item->plainText());
+    editorTimer_->start();
+
+    ui->actionUndo->setEnabled (false);
+    ui->actionRedo->setEnabled (false);
+    ui->actionCopy->setEnabled (false);
+    ui->actionCut->setEnabled (false);
+    ui->actionDelete->setEnabled (false);
+    ui->actionLink->setEnabled (false);
+    enableEditorActions (false);
+}
+/*************************/
+// Creates the editor of the previewed node, if any. It should be called before
+// anything that needs the current session (as in searching and replacing).
+void FN::endPreview()
+{
+    if (!previewEdit_ || ui->stackedWidget->currentWidget() != previewEdit_)
+        return;
+    editorTimer_->stop();
+    const QItemSelection sel = ui->treeView->selectionModel()->selection();
+    if (!sel.isEmpty())
+    {
+        lastSelChange_.invalidate(); // don't preview again
+        selChanged (sel, QItemSelection());
+    }
+    previewEdit_->clear();
+}
+/*************************/
+// Removes the editor of a node, if any, with everything kept for it.
+void FN::removeWidget (DomItem *item)
+{
+    delete takePrefetchedDoc (item);
+    QHash<DomItem*, NodeSession>::iterator it = sessions_.find (item);
+    if (it == sessions_.end()) return;
+    TextEdit *textEdit = it.value().editor;
+    sessions_.erase (it);
+    if (item == currentNode_)
+        currentNode_ = nullptr;
+    if (!textEdit) return;
+    recentNodes_.removeOne (item);
+    if (saveNeeded_ && textEdit->document()->isModified())
+        --saveNeeded_;
+    ui->stackedWidget->removeWidget (textEdit);
+    delete textEdit;
+}
+/*************************/
+// Closes the least recently shown editors when there are too many of them.
+// Only unmodified editors are closed because their nodes' texts are already
+// in the DOM tree, from which they will be read again when needed.
+void FN::closeOldWidgets()
+{
+    if (editorLimit_ < 0) return;
+    int i = 0;
+    while (recentNodes_.count() > editorLimit_ && i < recentNodes_.count())
+    {
+        DomItem *item = recentNodes_.at (i);
+        NodeSession &session = sessions_[item];
+        TextEdit *textEdit = session.editor;
+        if (item == currentNode_ || textEdit->document()->isModified())
+        {
+            ++i;
+            continue;
+        }
+        /* the revision of the document is no longer valid as a stamp */
+        if (model_->textIndex.isBuilt())
+            model_->textIndex.update (item, textEdit->toPlainText());
+        /* only the scroll position is remembered */
+        const int pos = textEdit->verticalScrollBar()->value();
+        session = NodeSession();
+        session.scrollPos = pos;
+        recentNodes_.removeAt (i);
+        ui->stackedWidget->removeWidget (textEdit);
+        delete textEdit;
+        ++closedWidgets_;
+    }
+    docProp();
+}
+/*************************/
+// Makes the documents of the nodes around the current one in other threads, so
+// that their editors can be shown quickly. This is called by a timer that is
+// restarted whenever a node is selected, so that browsing isn't slowed down.
+void FN::prefetchDocs()
+{
+    if (prefetching_) // wait for the last documents
+    {
+        prefetchTimer_->start();
+        return;
+    }
+    QModelIndex cur = ui->treeView->currentIndex();
+    if (!cur.isValid()) return;
+
+    /* the next and previous nodes, and the next sibling */
+    QList<QModelIndex> around;
+    around << model_->adjacentIndex (cur, true)
+           << cur.sibling (cur.row() + 1, 0)
+           << model_->adjacentIndex (cur, false);
+
+    QHash<DomItem*, PrefetchedDoc> kept;
+    QStringList texts;
+    QList<QPersistentModelIndex> nodes;
+    QVector<quint32> generations;
+    for (const QModelIndex &indx : around)
+    {
+        if (!indx.isValid()) continue;
+        DomItem *item = static_cast<DomItem*>(indx.internalPointer());
+        if (editorOf (item) || kept.contains (item)
+            || nodes.contains (QPersistentModelIndex (indx)))
+        {
+            continue;
+        }
+        if (QTextDocument *doc = takePrefetchedDoc (item))
+        {
+            PrefetchedDoc pd;
+            pd.doc = doc;
+            pd.generation = item->textGeneration();
+            kept.insert (item, pd);
+            continue;
+        }
+        texts << item->text();
+        nodes << QPersistentModelIndex (indx);
+        generations << item->textGeneration();
+    }
+    /* the documents of other nodes aren't needed anymore */
+    discardPrefetchedDocs();
+    prefetchedDocs_ = kept;
+    if (texts.isEmpty()) return;
+
+    DocumentMaker maker;
+    maker.font = defaultFont_;
+    maker.store = model_->imageStore;
+    prefetching_ = true;
+    QFutureWatcher<QTextDocument*> *watcher = new QFutureWatcher<QTextDocument*> (this);
+    connect (watcher, &QFutureWatcherBase::finished, this, [this, watcher, nodes, generations] {
+        prefetching_ = false;
+        const QList<QTextDocument*> docs = watcher->future().results();
+        watcher->deleteLater();
+        for (int i = 0; i < docs.count(); ++i)
+        {
+            QTextDocument *doc = docs.at (i);
+            const QPersistentModelIndex &node = nodes.at (i);
+            DomItem *item = node.isValid() ? static_cast<DomItem*>(node.internalPointer()) : nullptr;
+            /* the node may be closed, changed or shown in the meantime */
+            if (item == nullptr || editorOf (item) || prefetchedDocs_.contains (item)
+                || item->textGeneration() != generations.at (i))
+            {
+                delete doc;
+                continue;
+            }
+            PrefetchedDoc pd;
+            pd.doc = doc;
+            pd.generation = generations.at (i);
+            prefetchedDocs_.insert (item, pd);
+        }
+    });
+    watcher->setFuture (QtConcurrent::mapped (texts, maker));
+}
+/*************************/
+// Takes the prefetched document of a node if it's made
+// from the node's current text with the current font.
+QTextDocument *FN::takePrefetchedDoc (DomItem *item)
+{
+    QHash<DomItem*, PrefetchedDoc>::iterator it = prefetchedDocs_.find (item);
+    if (it == prefetchedDocs_.end()) return nullptr;
+    const PrefetchedDoc pd = it.value();
+    prefetchedDocs_.erase (it);
+    if (pd.generation == item->textGeneration()
+        && pd.doc->defaultFont() == defaultFont_)
+    {
+        return pd.doc;
+    }
+    delete pd.doc;
+    return nullptr;
+}
+/*************************/
+void FN::discardPrefetchedDocs()
+{
+    QHash<DomItem*, PrefetchedDoc>::const_iterator it = prefetchedDocs_.constBegin();
+    for (; it != prefetchedDocs_.constEnd(); ++it)
+        delete it.value().doc;
+    prefetchedDocs_.clear();
+}
+/*************************/
+TextEdit *FN::editorOf (DomItem *item) const
+{
+    QHash<DomItem*, NodeSession>::const_iterator it = sessions_.constFind (item);
+    return it == sessions_.constEnd() ? nullptr : it.value().editor;
+}
+/*************************/
+// The session of the node whose editor is shown.
+FN::NodeSession *FN::currentSession()
+{
+    QHash<DomItem*, NodeSession>::iterator it = sessions_.find (currentNode_);
+    return it == sessions_.end() || !it.value().editor ? nullptr : &it.value();
+}
+
+const FN::NodeSession *FN::currentSession() const
+{
+    QHash<DomItem*, NodeSession>::const_iterator it = sessions_.constFind (currentNode_);
+    return it == sessions_.constEnd() || !it.value().editor ? nullptr : &it.value();
+}
+/*************************/
+// Clears the search texts and highlights of all nodes.
+void FN::clearSearches()
+{
+    QHash<DomItem*, NodeSession>::iterator it;
+    for (it = sessions_.begin(); it != sessions_.end(); ++it)
+    {
+        it.value().searchEntry = QString();
+        it.value().greenSels.clear();
+        if (TextEdit *textEdit = it.value().editor)
+        {
+            disconnect (textEdit->verticalScrollBar(), &QAbstractSlider::valueChanged, this, &FN::scrolled);
+            disconnect (textEdit->horizontalScrollBar(), &QAbstractSlider::valueChanged, this, &FN::scrolled);
+            disconnect (textEdit, &TextEdit::resized, this, &FN::scheduleHlight);
+            disconnect (textEdit, &QTextEdit::textChanged, this, &FN::scheduleHlight);
+            textEdit->setExtraSelections (QList<QTextEdit::ExtraSelection>());
+        }
+    }
+}
+/*************************/
+// Removes the highlights of replaced matches in all nodes.
+void FN::removeGreenSels()
+{
+    QHash<DomItem*, NodeSession>::iterator it;
+    for (it = sessions_.begin(); it != sessions_.end(); ++it)
+    {
+        it.value().greenSels.clear();
+        if (it.value().editor)
+            it.value().editor->setExtraSelections (QList<QTextEdit::ExtraSelection>());
+    }
+}
+/*************************/
 void FN::setSaveEnabled (bool modified)
 {
     if (modified)
-        noteModified();
+        countModification(); // a text change can be journaled
     else
     {
         if (saveNeeded_)
@@ -2185,18 +3018,9 @@ void FN::deleteNode()
     list << index;
     for (int i = 0; i < list.count(); ++i)
     {
-        QHash<DomItem*, TextEdit*>::iterator it = widgets_.find (static_cast<DomItem*>(list.at (i).internalPointer()));
-        if (it != widgets_.end())
-        {
-            TextEdit *textEdit = it.value();
-            if (saveNeeded_ && textEdit->document()->isModified())
-                --saveNeeded_;
-            searchEntries_.remove (textEdit);
-            greenSels_.remove (textEdit);
-            ui->stackedWidget->removeWidget (textEdit);
-            delete textEdit;
-            widgets_.remove (it.key());
-        }
+        DomItem *item = static_cast<DomItem*>(list.at (i).internalPointer());
+        removeWidget (item);
+        changedTexts_.remove (item);
     }
 
     /* now, really remove the node */
@@ -2467,19 +3291,29 @@ void FN::toggleStatusBar()
     {
         statusLabel->setText (tr ("<b>Main nodes:</b> <i>%1</i>"
                                   "&nbsp;&nbsp;&nbsp;&nbsp;<b>All nodes:</b> <i>%2</i>")
-                              .arg (rows).arg (allNodes));
+                              .arg (rows).arg (allNodes)
+                              + editorsInfo());
     }
     else
     {
         statusLabel->setText (tr ("<b>Note:</b> <i>%1</i><br>"
                                   "<b>Main nodes:</b> <i>%2</i>"
                                   "&nbsp;&nbsp;&nbsp;&nbsp;<b>All nodes:</b> <i>%3</i>")
-                              .arg (xmlPath_).arg (rows).arg (allNodes));
+                              .arg (xmlPath_).arg (rows).arg (allNodes)
+                              + editorsInfo());
     }
     ui->statusBar->addWidget (statusLabel);
     ui->statusBar->setVisible (true);
 }
 /*************************/
+// The number of node editors, shown in the statusbar because they take memory.
+QString FN::editorsInfo() const
+{
+    return tr ("<br><b>Node editors:</b> <i>%1</i>"
+               "&nbsp;&nbsp;&nbsp;&nbsp;<b>Closed to save memory:</b> <i>%2</i>")
+           .arg (recentNodes_.count()).arg (closedWidgets_);
+}
+/*************************/
 void FN::docProp()
 {
     if (!ui->statusBar->isVisible()) return;
@@ -2500,23 +3334,22 @@ void FN::docProp()
     {
         statusLabel->setText (tr ("<b>Main nodes:</b> <i>%1</i>"
                                   "&nbsp;&nbsp;&nbsp;&nbsp;<b>All nodes:</b> <i>%2</i>")
-                              .arg (rows).arg (allNodes));
+                              .arg (rows).arg (allNodes)
+                              + editorsInfo());
     }
     else
     {
         statusLabel->setText (tr ("<b>Note:</b> <i>%1</i><br>"
                                   "<b>Main nodes:</b> <i>%2</i>"
                                   "&nbsp;&nbsp;&nbsp;&nbsp;<b>All nodes:</b> <i>%3</i>")
-                              .arg (xmlPath_).arg (rows).arg (allNodes));
+                              .arg (xmlPath_).arg (rows).arg (allNodes)
+                              + editorsInfo());
     }
 }
 /*************************/
 void FN::setNewFont (DomItem *item, QTextCharFormat &fmt)
 {
-    QString text;
-    QDomNodeList list = item->node().childNodes();
-    if (!list.item (0).isText()) return;
-    text = list.item (0).nodeValue();
+    QString text = item->text();
     if (!text.startsWith ("<!DOCTYPE HTML PUBLIC"))
         return;
 
@@ -2530,8 +3363,7 @@ void FN::setNewFont (DomItem *item, QTextCharFormat &fmt)
     cursor.select (QTextCursor::Document);
     cursor.mergeCharFormat (fmt);
 
-    text = textEdit->toHtml();
-    list.item (0).setNodeValue (text);
+    item->setText (textEdit->toHtml());
 
     delete textEdit;
 }
@@ -2553,19 +3385,21 @@ void FN::textFontDialog()
         fmt.setFontPointSize (defaultFont_.pointSize());
 
         /* change the font for all shown nodes */
-        QHash<DomItem*, TextEdit*>::iterator it;
-        for (it = widgets_.begin(); it != widgets_.end(); ++it)
+        QHash<DomItem*, NodeSession>::iterator it;
+        for (it = sessions_.begin(); it != sessions_.end(); ++it)
         {
-            it.value()->document()->setDefaultFont (defaultFont_);
+            TextEdit *textEdit = it.value().editor;
+            if (!textEdit) continue;
+            textEdit->document()->setDefaultFont (defaultFont_);
 #if (QT_VERSION >= QT_VERSION_CHECK(5,11,0))
             QFontMetricsF metrics (defaultFont_);
-            it.value()->setTabStopDistance (4 * metrics.horizontalAdvance (' '));
+            textEdit->setTabStopDistance (4 * metrics.horizontalAdvance (' '));
 #elif (QT_VERSION >= QT_VERSION_CHECK(5,10,0))
             QFontMetricsF metrics (defaultFont_);
-            it.value()->setTabStopDistance (4 * metrics.width (' '));
+            textEdit->setTabStopDistance (4 * metrics.width (' '));
 #else
             QFontMetrics metrics (defaultFont_);
-            it.value()->setTabStopWidth (4 * metrics.width (' '));
+            textEdit->setTabStopWidth (4 * metrics.width (' '));
 #endif
         }
 
@@ -2575,13 +3409,13 @@ void FN::textFontDialog()
         {
             QModelIndex index = model_->index (i, 0, QModelIndex());
             DomItem *item = static_cast<DomItem*>(index.internalPointer());
-            if (!widgets_.contains (item))
+            if (!editorOf (item))
                 setNewFont (item, fmt);
             QModelIndexList list = model_->allDescendants (index);
             for (int j = 0; j < list.count(); ++j)
             {
                 item = static_cast<DomItem*>(list.at (j).internalPointer());
-                if (!widgets_.contains (item))
+                if (!editorOf (item))
                     setNewFont (item, fmt);
             }
         }
@@ -2610,6 +3444,12 @@ void FN::nodeFontDialog()
 }
 /*************************/
 void FN::noteModified()
+{
+    structureModified_ = true;
+    countModification();
+}
+/*************************/
+void FN::countModification()
 {
     if (model_->rowCount() == 0) // if the last node is closed
     {
@@ -2649,6 +3489,8 @@ void FN::showHideSearch()
     ui->prevButton->setVisible (!visibility);
     ui->caseButton->setVisible (!visibility);
     ui->wholeButton->setVisible (!visibility);
+    ui->regexButton->setVisible (!visibility);
+    ui->fuzzyButton->setVisible (!visibility);
     ui->everywhereButton->setVisible (!visibility);
     ui->tagsButton->setVisible (!visibility);
     ui->namesButton->setVisible (!visibility);
@@ -2663,22 +3505,13 @@ void FN::showHideSearch()
             /* return focus to the document */
             qobject_cast< TextEdit *>(cw)->setFocus();
             /* cancel search */
-            QHash<TextEdit*,QString>::iterator it;
-            for (it = searchEntries_.begin(); it != searchEntries_.end(); ++it)
-            {
-                ui->lineEdit->setText (QString());
-                it.value() = QString();
-                disconnect (it.key()->verticalScrollBar(), &QAbstractSlider::valueChanged, this, &FN::scrolled);
-                disconnect (it.key()->horizontalScrollBar(), &QAbstractSlider::valueChanged, this, &FN::scrolled);
-                disconnect (it.key(), &TextEdit::resized, this, &FN::hlight);
-                disconnect (it.key(), &QTextEdit::textChanged, this, &FN::hlight);
-                QList<QTextEdit::ExtraSelection> extraSelections;
-                greenSels_[it.key()] = extraSelections;
-                it.key()->setExtraSelections (extraSelections);
-            }
+            ui->lineEdit->setText (QString());
+            clearSearches();
             ui->everywhereButton->setChecked (false);
             ui->tagsButton->setChecked (false);
             ui->namesButton->setChecked (false);
+            ui->regexButton->setChecked (false);
+            ui->fuzzyButton->setChecked (false);
         }
     }
 }
@@ -2891,7 +3724,15 @@ void FN::closeTagsDialog()
 /*************************/
 void FN::scrolled (int) const
 {
-    hlight();
+    scheduleHlight();
+}
+/*************************/
+// Highlights found matches after the pending events are processed,
+// so that a burst of scroll or resize events leads to one update.
+void FN::scheduleHlight() const
+{
+    if (!hlightTimer_->isActive())
+        hlightTimer_->start();
 }
 /*************************/
 void FN::allBtn (bool checked)
@@ -2900,7 +3741,27 @@ void FN::allBtn (bool checked)
     {
         ui->tagsButton->setChecked (false);
         ui->namesButton->setChecked (false);
+        ui->regexButton->setChecked (false);
+        ui->fuzzyButton->setChecked (false);
+    }
+}
+/*************************/
+// Regex and fuzzy searches list their matches in all nodes.
+void FN::patternBtn (bool checked)
+{
+    if (checked)
+    {
+        if (QObject::sender() == ui->regexButton)
+            ui->fuzzyButton->setChecked (false);
+        else
+            ui->regexButton->setChecked (false);
+        ui->everywhereButton->setChecked (false);
+        ui->tagsButton->setChecked (false);
+        ui->namesButton->setChecked (false);
     }
+    if (QObject::sender() == ui->fuzzyButton)
+        ui->wholeButton->setEnabled (!checked); // typos may be anywhere
+    cancelFindAll();
 }
 /*************************/
 void FN::tagsAndNamesBtn (bool checked)
@@ -2913,20 +3774,7 @@ void FN::tagsAndNamesBtn (bool checked)
         /* first clear all search info except the search
            entry's text but don't do redundant operations */
         if (!ui->tagsButton->isChecked() || !ui->namesButton->isChecked())
-        {
-            QHash<TextEdit*,QString>::iterator it;
-            for (it = searchEntries_.begin(); it != searchEntries_.end(); ++it)
-            {
-                it.value() = QString();
-                disconnect (it.key()->verticalScrollBar(), &QAbstractSlider::valueChanged, this, &FN::scrolled);
-                disconnect (it.key()->horizontalScrollBar(), &QAbstractSlider::valueChanged, this, &FN::scrolled);
-                disconnect (it.key(), &TextEdit::resized, this, &FN::hlight);
-                disconnect (it.key(), &QTextEdit::textChanged, this, &FN::hlight);
-                QList<QTextEdit::ExtraSelection> extraSelections;
-                greenSels_[it.key()] = extraSelections;
-                it.key()->setExtraSelections (extraSelections);
-            }
-        }
+            clearSearches();
         else // then uncheck the other radio buttons
         {
             if (QObject::sender() == ui->tagsButton)
@@ -2935,6 +3783,8 @@ void FN::tagsAndNamesBtn (bool checked)
                 ui->tagsButton->setChecked (false);
         }
         ui->everywhereButton->setChecked (false);
+        ui->regexButton->setChecked (false);
+        ui->fuzzyButton->setChecked (false);
     }
     if (QObject::sender() == ui->tagsButton)
     {
@@ -2955,6 +3805,8 @@ void FN::replaceDock()
             ui->prevButton->setVisible (true);
             ui->caseButton->setVisible (true);
             ui->wholeButton->setVisible (true);
+            ui->regexButton->setVisible (true);
+            ui->fuzzyButton->setVisible (true);
             ui->everywhereButton->setVisible (true);
             ui->tagsButton->setVisible (true);
             ui->namesButton->setVisible (true);
@@ -2982,13 +3834,7 @@ void FN::closeReplaceDock (bool visible)
 
     txtReplace_.clear();
     /* remove green highlights */
-    QHash<TextEdit*,QList<QTextEdit::ExtraSelection> >::iterator it;
-    for (it = greenSels_.begin(); it != greenSels_.end(); ++it)
-    {
-        QList<QTextEdit::ExtraSelection> extraSelectionsIth;
-        greenSels_[it.key()] = extraSelectionsIth;
-        it.key()->setExtraSelections (QList<QTextEdit::ExtraSelection>());
-    }
+    removeGreenSels();
     hlight();
 
     /* return focus to the document */
@@ -3006,6 +3852,7 @@ void FN::resizeDock (bool topLevel)
 /*************************/
 void FN::replace()
 {
+    endPreview();
     QWidget *cw = ui->stackedWidget->currentWidget();
     if (!cw) return;
 
@@ -3021,13 +3868,7 @@ void FN::replace()
         txtReplace_ = ui->lineEditReplace->text();
         /* remove previous green highlights
            if the replacing text is changed */
-        QHash<TextEdit*,QList<QTextEdit::ExtraSelection> >::iterator it;
-        for (it = greenSels_.begin(); it != greenSels_.end(); ++it)
-        {
-            QList<QTextEdit::ExtraSelection> extraSelectionsIth;
-            greenSels_[it.key()] = extraSelectionsIth;
-            it.key()->setExtraSelections (QList<QTextEdit::ExtraSelection>());
-        }
+        removeGreenSels();
         hlight();
     }
 
@@ -3055,7 +3896,7 @@ void FN::replace()
     else
         found = finding (txtFind, start, searchFlags_ | QTextDocument::FindBackward);
 
-    QList<QTextEdit::ExtraSelection> gsel = greenSels_[textEdit];
+    QList<QTextEdit::ExtraSelection> gsel = currentSession()->greenSels;
     QModelIndex nxtIndx;
     if (found.isNull())
     {
@@ -3064,20 +3905,12 @@ void FN::replace()
             nxtIndx = ui->treeView->currentIndex();
             Qt::CaseSensitivity cs = Qt::CaseInsensitive;
             if (ui->caseButton->isChecked()) cs = Qt::CaseSensitive;
-            QString text;
-            while (!text.contains (txtFind, cs))
+            updateTextIndex();
+            do
             {
                 nxtIndx = model_->adjacentIndex (nxtIndx, !backwardSearch);
-                if (!nxtIndx.isValid()) break;
-                DomItem *item = static_cast<DomItem*>(nxtIndx.internalPointer());
-                if (TextEdit *thisTextEdit = widgets_.value (item))
-                    text = thisTextEdit->toPlainText(); // the node text may have been edited
-                else
-                {
-                    QDomNodeList list = item->node().childNodes();
-                    text = list.item (0).nodeValue();
-                }
-            }
+            } while (nxtIndx.isValid()
+                     && !nodeContains (static_cast<DomItem*>(nxtIndx.internalPointer()), txtFind, cs));
         }
         rplOtherNode_ = false;
     }
@@ -3128,7 +3961,7 @@ void FN::replace()
         }
     }
 
-    greenSels_[textEdit] = gsel;
+    currentSession()->greenSels = gsel;
     textEdit->setExtraSelections (extraSelections);
     hlight();
 
@@ -3140,93 +3973,145 @@ void FN::replace()
     }
 }
 /*************************/
+// Replaces all matches in the current node or, when searching everywhere, in all nodes.
+// Nodes that aren't shown are changed without creating widgets for them.
 void FN::replaceAll()
 {
     QString txtFind = ui->lineEditFind->text();
     if (txtFind.isEmpty()) return;
 
-    Qt::CaseSensitivity cs = Qt::CaseInsensitive;
-    if (ui->caseButton->isChecked()) cs = Qt::CaseSensitive;
+    endPreview();
+    QWidget *cw = ui->stackedWidget->currentWidget();
+    if (!cw) return;
+    TextEdit *textEdit = qobject_cast< TextEdit *>(cw);
 
-    QModelIndex nxtIndx;
-    /* start with the first node when replacing everywhere */
-    if (!rplOtherNode_ && ui->everywhereButton->isChecked())
+    if (txtReplace_ != ui->lineEditReplace->text())
     {
-        nxtIndx = model_->index (0, 0);
-        DomItem *item = static_cast<DomItem*>(nxtIndx.internalPointer());
-        QString text;
-        if (TextEdit *thisTextEdit = widgets_.value (item))
-            text = thisTextEdit->toPlainText(); // the node text may have been edited
-        else
+        txtReplace_ = ui->lineEditReplace->text();
+        removeGreenSels();
+        hlight();
+    }
+
+    int replCount = 0;
+    int nodeCount = 0;
+    if (!ui->everywhereButton->isChecked())
+    {
+        replCount = replaceAllInWidget (*currentSession());
+        if (replCount > 0)
+            nodeCount = 1;
+    }
+    else
+    {
+        Qt::CaseSensitivity cs = Qt::CaseInsensitive;
+        if (ui->caseButton->isChecked()) cs = Qt::CaseSensitive;
+
+        /* first find the nodes that may have matches */
+        updateTextIndex();
+        QList<DomItem*> items;
+        QModelIndex indx = model_->index (0, 0);
+        while (indx.isValid())
+        {
+            DomItem *item = static_cast<DomItem*>(indx.internalPointer());
+            if (nodeContains (item, txtFind, cs))
+                items << item;
+            indx = model_->adjacentIndex (indx, true);
+        }
+
+        /* nodes without editors are changed directly in the DOM,
+           where there is no undo stack, so ask for confirmation */
+        int hiddenCount = 0;
+        for (int i = 0; i < items.count(); ++i)
         {
-            QDomNodeList list = item->node().childNodes();
-            text = list.item (0).nodeValue();
+            QHash<DomItem*, NodeSession>::const_iterator sit = sessions_.constFind (items.at (i));
+            if (sit == sessions_.constEnd() || !sit.value().editor)
+                ++hiddenCount;
         }
-        while (!text.contains (txtFind, cs))
+        if (hiddenCount > 0)
         {
-            nxtIndx = model_->adjacentIndex (nxtIndx, true);
-            if (!nxtIndx.isValid())
-            {
-                ui->dockReplace->setWindowTitle (tr ("No Match"));
+            MessageBox msgBox;
+            msgBox.setIcon (QMessageBox::Question);
+            msgBox.setWindowTitle (tr ("Replacement"));
+            msgBox.setText (tr ("<center><b><big>Replace in unopened nodes?</big></b></center>"));
+            msgBox.setInformativeText (tr ("<center>Nodes that have not been opened: %1</center>\n"\
+                                           "<center><b><i>Warning!</i></b></center>\n"\
+                                           "<center>Their changes cannot be undone.</center>").arg (hiddenCount));
+            msgBox.setStandardButtons (QMessageBox::Yes | QMessageBox::No);
+            msgBox.changeButtonText (QMessageBox::Yes, tr ("Yes"));
+            msgBox.changeButtonText (QMessageBox::No, tr ("No"));
+            msgBox.setDefaultButton (QMessageBox::No);
+            msgBox.setParent (this, Qt::Dialog);
+            msgBox.setWindowModality (Qt::WindowModal);
+            msgBox.show();
+            msgBox.move (x() + width()/2 - msgBox.width()/2,
+                         y() + height()/2 - msgBox.height()/ 2);
+            switch (msgBox.exec()) {
+            case QMessageBox::Yes:
+                break;
+            case QMessageBox::No:
+            default:
                 return;
             }
-            item = static_cast<DomItem*>(nxtIndx.internalPointer());
-            if (TextEdit *thisTextEdit = widgets_.value (item))
-                text = thisTextEdit->toPlainText();
-            else
-            {
-                QDomNodeList list = item->node().childNodes();
-                text = list.item (0).nodeValue();
-            }
         }
-        rplOtherNode_ = true;
-        ui->treeView->setCurrentIndex (nxtIndx);
-        nxtIndx = QModelIndex();
-    }
-
-    QWidget *cw = ui->stackedWidget->currentWidget();
-    if (!cw) return;
-    TextEdit *textEdit = qobject_cast< TextEdit *>(cw);
 
-    if (txtReplace_ != ui->lineEditReplace->text())
-    {
-        txtReplace_ = ui->lineEditReplace->text();
-        QHash<TextEdit*,QList<QTextEdit::ExtraSelection> >::iterator it;
-        for (it = greenSels_.begin(); it != greenSels_.end(); ++it)
+        QProgressDialog progress (tr ("Replacing..."), tr ("Cancel"), 0, items.count(), this);
+        progress.setWindowModality (Qt::WindowModal);
+        progress.setMinimumDuration (500);
+        bool hiddenChanged = false;
+        for (int i = 0; i < items.count(); ++i)
         {
-            QList<QTextEdit::ExtraSelection> extraSelectionsIth;
-            greenSels_[it.key()] = extraSelectionsIth;
-            it.key()->setExtraSelections (QList<QTextEdit::ExtraSelection>());
+            progress.setValue (i);
+            if (progress.wasCanceled()) break; // the replacements made so far are kept
+            DomItem *item = items.at (i);
+            int n;
+            QHash<DomItem*, NodeSession>::iterator sit = sessions_.find (item);
+            if (sit != sessions_.end() && sit.value().editor)
+                n = replaceAllInWidget (sit.value());
+            else if ((n = replaceAllInNode (item)) > 0)
+                hiddenChanged = true;
+            if (n > 0)
+            {
+                replCount += n;
+                ++nodeCount;
+            }
         }
-        hlight();
+        progress.setValue (items.count());
+        if (hiddenChanged)
+            countModification();
     }
+    hlight();
 
+    if (replCount == 0)
+        ui->dockReplace->setWindowTitle (tr ("No Replacement"));
+    else if (replCount == 1)
+        ui->dockReplace->setWindowTitle (tr ("One Replacement"));
+    else if (nodeCount == 1)
+        ui->dockReplace->setWindowTitle (tr ("%1 Replacements").arg (replCount));
+    else
+        ui->dockReplace->setWindowTitle (tr ("%1 Replacements in %2 Nodes").arg (replCount).arg (nodeCount));
+}
+/*************************/
+// Replaces all matches in the document of an editor as a single undoable
+// edit and returns the number of replacements.
+int FN::replaceAllInWidget (NodeSession &session)
+{
+    TextEdit *textEdit = session.editor;
     QTextCursor orig = textEdit->textCursor();
     QTextCursor start = orig;
     QColor green = QColor (Qt::green);
     QColor black = QColor (Qt::black);
     int pos; QTextCursor found;
+    int count = 0;
     start.beginEditBlock();
     start.setPosition (0);
     QTextCursor tmp = start;
-    QList<QTextEdit::ExtraSelection> gsel = greenSels_[textEdit];
-    QList<QTextEdit::ExtraSelection> extraSelections;
-    while (!(found = finding (txtFind, start, searchFlags_)).isNull())
+    QList<QTextEdit::ExtraSelection> gsel = session.greenSels;
+    while (!(found = finding (textEdit->document(), ui->lineEditFind->text(), start, searchFlags_)).isNull())
     {
         start.setPosition (found.anchor());
         pos = found.anchor();
         start.setPosition (found.position(), QTextCursor::KeepAnchor);
         start.insertText (txtReplace_);
 
-        if (rplOtherNode_)
-        {
-            QList<int> sizes = ui->splitter->sizes();
-            QList<int> newSizes; newSizes << sizes.first() + 1 << sizes.last() - 1;
-            ui->splitter->setSizes (newSizes);
-            ui->splitter->setSizes (sizes);
-            rplOtherNode_ = false;
-        }
-
         tmp.setPosition (pos);
         tmp.setPosition (start.position(), QTextCursor::KeepAnchor);
         start.setPosition (start.position());
@@ -3235,54 +4120,46 @@ void FN::replaceAll()
         extra.format.setUnderlineStyle (QTextCharFormat::WaveUnderline);
         extra.format.setUnderlineColor (black);
         extra.cursor = tmp;
-        extraSelections.prepend (extra);
         gsel.append (extra);
-        ++replCount_;
+        ++count;
     }
-    rplOtherNode_ = false;
-    greenSels_[textEdit] = gsel;
+    session.greenSels = gsel;
     start.endEditBlock();
-    textEdit->setExtraSelections (extraSelections);
-    hlight();
+    textEdit->setExtraSelections (gsel);
     /* restore the original cursor without selection */
     orig.setPosition (orig.anchor());
     textEdit->setTextCursor (orig);
+    return count;
+}
+/*************************/
+// Replaces all matches in the text of a node that has no editor, by using
+// an off-screen document, and returns the number of replacements.
+int FN::replaceAllInNode (DomItem *item)
+{
+    QTextDocument txtdoc;
+    txtdoc.setDefaultFont (defaultFont_);
+    txtdoc.setHtml (withPlainBody (item->text()));
 
-    if (ui->everywhereButton->isChecked() && model_->rowCount() > 1)
+    QTextCursor start (&txtdoc);
+    QTextCursor found;
+    int count = 0;
+    start.beginEditBlock();
+    while (!(found = finding (&txtdoc, ui->lineEditFind->text(), start, searchFlags_)).isNull())
     {
-        nxtIndx = ui->treeView->currentIndex();
-        QString text;
-        while (!text.contains (txtFind, cs))
-        {
-            nxtIndx = model_->adjacentIndex (nxtIndx, true);
-            if (!nxtIndx.isValid()) break;
-            DomItem *item = static_cast<DomItem*>(nxtIndx.internalPointer());
-            if (TextEdit *thisTextEdit = widgets_.value (item))
-                text = thisTextEdit->toPlainText();
-            else
-            {
-                QDomNodeList list = item->node().childNodes();
-                text = list.item (0).nodeValue();
-            }
-        }
+        start.setPosition (found.anchor());
+        start.setPosition (found.position(), QTextCursor::KeepAnchor);
+        start.insertText (txtReplace_);
+        ++count;
     }
+    start.endEditBlock();
+    if (count == 0) return 0;
 
-    if (nxtIndx.isValid())
-    {
-        rplOtherNode_ = true;
-        ui->treeView->setCurrentIndex (nxtIndx);
-        replaceAll();
-    }
-    else
-    {
-        if (replCount_ == 0)
-            ui->dockReplace->setWindowTitle (tr ("No Replacement"));
-        else if (replCount_ == 1)
-            ui->dockReplace->setWindowTitle (tr ("One Replacement"));
-        else
-            ui->dockReplace->setWindowTitle (tr ("%1 Replacements").arg (replCount_));
-        replCount_ = 0;
-    }
+    const QString plain = txtdoc.toPlainText();
+    item->setText (plain.isEmpty() ? QString() : txtdoc.toHtml()); // like setNodesTexts()
+    changedTexts_ << item;
+    if (model_->textIndex.isBuilt())
+        model_->textIndex.update (item, plain);
+    return count;
 }
 /*************************/
 void FN::showEvent (QShowEvent *event)
@@ -3580,26 +4457,60 @@ void FN::embedImage()
     imageEmbed (lastImgPath_);
 }
 /*************************/
+// Re-encodes an image with the given size if that makes it smaller.
+// Called in another thread.
+static QByteArray shrunkImage (const QByteArray &data, const QSize &size)
+{
+    QBuffer buffer;
+    buffer.setData (data);
+    buffer.open (QIODevice::ReadOnly);
+    QImageReader reader (&buffer);
+    QByteArray format = reader.format();
+    reader.setScaledSize (size); // JPEG images are scaled while being decoded
+    const QImage img = reader.read();
+    if (img.isNull())
+        return data;
+
+    if (!QImageWriter::supportedImageFormats().contains (format))
+        format = "png";
+    QByteArray res;
+    QBuffer out (&res);
+    out.open (QIODevice::WriteOnly);
+    QImageWriter writer (&out, format);
+    if (!writer.write (img) || res.size() >= data.size())
+        return data;
+    return res;
+}
+/*************************/
+QString FN::imageSource (const QByteArray &data)
+{
+    if (imageStore_)
+        return ImageStore::url (model_->imageStore.add (data));
+    return "data:image;base64," + QString::fromLatin1 (data.toBase64());
+}
+/*************************/
+QString FN::imageHtml (const QByteArray &data, int w, int h)
+{
+    //QString ("<img src=\"data:image/png;base64,%1\">")
+    return QString ("<img src=\"%1\" width=\"%2\" height=\"%3\" />")
+           .arg (imageSource (data))
+           .arg (w)
+           .arg (h);
+}
+/*************************/
 void FN::imageEmbed (const QString &path)
 {
     if (path.isEmpty()) return;
+    endPreview();
 
-    QFile file (path);
-    if (!file.open (QIODevice::ReadOnly))
-        return;
-    /* read the data serialized from the file */
-    QDataStream in (&file);
-    QByteArray rawarray;
-    QDataStream datastream (&rawarray, QIODevice::WriteOnly);
-    char a;
-    /* copy between the two data streams */
-    while (in.readRawData (&a, 1) != 0)
-        datastream.writeRawData (&a, 1);
-    file.close();
-    QByteArray base64array = rawarray.toBase64();
-
-    QImage img = QImage (path);
-    QSize imgSize = img.size();
+    /* only the header is read to find the size */
+    QImageReader reader (path);
+    QSize imgSize = reader.size();
+    if (!imgSize.isValid())
+    {
+        if (!reader.canRead()) return;
+        imgSize = reader.read().size();
+    }
     int w, h;
     if (QObject::sender() == ui->actionEmbedImage)
     {
@@ -3611,12 +4522,44 @@ void FN::imageEmbed (const QString &path)
         w = imgSize.width();
         h = imgSize.height();
     }
+    if (w <= 0 || h <= 0) return;
     TextEdit *textEdit = qobject_cast< TextEdit *>(ui->stackedWidget->currentWidget());
-    //QString ("<img src=\"data:image/png;base64,%1\">")
-    textEdit->insertHtml (QString ("<img src=\"data:image;base64,%1\" width=\"%2\" height=\"%3\" />")
-                          .arg (QString (base64array))
-                          .arg (w)
-                          .arg (h));
+
+    QFile file (path);
+    if (!file.open (QIODevice::ReadOnly))
+        return;
+    const QByteArray data = file.readAll();
+    file.close();
+    /* the whole image is embedded at once, so that
+       the document can be saved or closed at any time */
+    const QString src = imageSource (data);
+    textEdit->insertHtml (QString ("<img src=\"%1\" width=\"%2\" height=\"%3\" />")
+                          .arg (src).arg (w).arg (h));
+
+    if (shrinkImages_ && (w < imgSize.width() || h < imgSize.height()))
+    {
+        /* replace the image with its shrunk copy when it's ready;
+           this cursor follows the image while the text is edited */
+        QTextCursor mark = textEdit->textCursor();
+        mark.clearSelection();
+        mark.movePosition (QTextCursor::PreviousCharacter);
+
+        QPointer<TextEdit> editor (textEdit);
+        QFutureWatcher<QByteArray> *watcher = new QFutureWatcher<QByteArray> (this);
+        connect (watcher, &QFutureWatcherBase::finished, this, [this, watcher, editor, mark, src, data, w, h] {
+            const QByteArray shrunk = watcher->result();
+            watcher->deleteLater();
+            /* if the node or document is closed, the whole image is kept */
+            if (editor == nullptr || shrunk.size() >= data.size()) return;
+            QTextCursor cur (mark);
+            cur.movePosition (QTextCursor::NextCharacter, QTextCursor::KeepAnchor);
+            const QTextCharFormat fmt = cur.charFormat();
+            if (!fmt.isImageFormat() || fmt.toImageFormat().name() != src)
+                return; // the image is removed
+            cur.insertHtml (imageHtml (shrunk, w, h));
+        });
+        watcher->setFuture (QtConcurrent::run (shrunkImage, data, QSize (w, h)));
+    }
 
     raise();
     activateWindow();
@@ -3717,7 +4660,7 @@ void FN::scaleImage()
     if (docFrag.isEmpty()) return;
     QString txt = docFrag.toHtml();
 
-    QRegularExpression imageExp (R"((?<=\s)src\s*=\s*"data:[^<>]*;base64\s*,[a-zA-Z0-9+=/\s]+)");
+    QRegularExpression imageExp (R"((?<=\s)src\s*=\s*"(data:[^<>]*;base64\s*,[a-zA-Z0-9+=/\s]+|fnimg:[0-9a-f]+))");
     QRegularExpressionMatch match;
     QSize imageSize;
     int W = 0, H = 0;
@@ -3728,9 +4671,9 @@ void FN::scaleImage()
     QString str = txt.mid (startIndex, match.capturedLength());
     int indx = str.lastIndexOf (imageExp, -1, &match);
     QString imgStr = str.mid (indx, match.capturedLength());
-    imgStr.remove (QRegularExpression (R"(src\s*=\s*"data:[^<>]*;base64\s*,)"));
+    imgStr.remove (QRegularExpression (R"(^src\s*=\s*")"));
     QImage image;
-    if (image.loadFromData (QByteArray::fromBase64 (imgStr.toUtf8())))
+    if (image.loadFromData (imageSourceData (imgStr, model_->imageStore)))
         imageSize = image.size();
     if (imageSize.isEmpty()) return;
 
@@ -3796,9 +4739,9 @@ void FN::scaleImage()
                 continue;
             }
             imgStr = str.mid (pos, imageMatch.capturedLength());
-            imgStr.remove (QRegularExpression (R"(src\s*=\s*"data:[^<>]*;base64\s*,)"));
+            imgStr.remove (QRegularExpression (R"(^src\s*=\s*")"));
             QImage image;
-            if (!image.loadFromData (QByteArray::fromBase64 (imgStr.toUtf8())))
+            if (!image.loadFromData (imageSourceData (imgStr, model_->imageStore)))
             {
                 startIndex = indx + match.capturedLength();
                 continue;
@@ -3809,7 +4752,7 @@ void FN::scaleImage()
 
         W = imageSize.width() * scale / 100;
         H = imageSize.height() * scale / 100;
-        txt.replace (indx, match.capturedLength(), "<img src=\"data:image;base64," + imgStr + QString ("\" width=\"%1\" height=\"%2\">").arg (W).arg (H));
+        txt.replace (indx, match.capturedLength(), "<img src=\"" + imgStr + QString ("\" width=\"%1\" height=\"%2\">").arg (W).arg (H));
         imageSize = QSize(); // for the next image
 
         /* since the text is changed, startIndex should be found again */
@@ -3836,7 +4779,7 @@ void FN::saveImage()
         path = dir.path();
 
         QString shownName = QFileInfo (xmlPath_).fileName();
-        if (shownName.endsWith (".fnx"))
+        if (shownName.endsWith (".fnx") || shownName.endsWith (".fnb") || shownName.endsWith (".fnd"))
             shownName.chop (4);
         path += "/" + shownName;
     }
@@ -3847,7 +4790,7 @@ void FN::saveImage()
         path += "/" + tr ("untitled");
     }
 
-    QRegularExpression imageExp (R"((?<=\s)src\s*=\s*"data:[^<>]*;base64\s*,[a-zA-Z0-9+=/\s]+)");
+    QRegularExpression imageExp (R"((?<=\s)src\s*=\s*"(data:[^<>]*;base64\s*,[a-zA-Z0-9+=/\s]+|fnimg:[0-9a-f]+))");
     int indx;
     int startIndex = 0;
     int n = 1;
@@ -3862,9 +4805,9 @@ void FN::saveImage()
 
         if (indx == -1) continue;
         str = str.mid (indx, match.capturedLength());
-        str.remove (QRegularExpression (R"(src\s*=\s*"data:[^<>]*;base64\s*,)"));
+        str.remove (QRegularExpression (R"(^src\s*=\s*")"));
         QImage image;
-        if (!image.loadFromData (QByteArray::fromBase64 (str.toUtf8())))
+        if (!image.loadFromData (imageSourceData (str, model_->imageStore)))
             continue;
 
         bool retry (true);
@@ -4242,6 +5185,14 @@ void FN::setUnderE (bool yes)
     }
 }
 /*************************/
+void FN::setImageStore (bool store)
+{
+    if (imageStore_ == store) return;
+    imageStore_ = store;
+    for (int i = 0; i < ui->stackedWidget->count(); ++i)
+        qobject_cast< TextEdit *>(ui->stackedWidget->widget (i))->setImageStore (&model_->imageStore, store);
+}
+/*************************/
 void FN::enableScrollJumpWorkaround (bool enable)
 {
     if (enable)
@@ -4509,6 +5460,8 @@ void FN::readAndApplyConfig (bool startup)
         ui->everywhereButton->setIcon (symbolicIcon::icon (":icons/all.svg"));
         ui->wholeButton->setIcon (symbolicIcon::icon (":icons/whole.svg"));
         ui->caseButton->setIcon (symbolicIcon::icon (":icons/case.svg"));
+        ui->regexButton->setIcon (symbolicIcon::icon (":icons/regex.svg"));
+        ui->fuzzyButton->setIcon (symbolicIcon::icon (":icons/fuzzy.svg"));
 
         icn = QIcon::fromTheme ("feathernotes");
         if (icn.isNull())
@@ -4558,11 +5511,33 @@ void FN::readAndApplyConfig (bool startup)
             timer_->stop();
     }
 
+    editorLimit_ = settings.value ("editorLimit", 100).toInt();
+    if (editorLimit_ > -1)
+        editorLimit_ = qBound (5, editorLimit_, 1000);
+
     scrollJumpWorkaround_ = settings.value ("scrollJumpWorkaround").toBool(); // false by default
     if (!startup)
         enableScrollJumpWorkaround (scrollJumpWorkaround_);
 
     settings.endGroup();
+
+    /*************
+     *** Files ***
+     *************/
+
+    settings.beginGroup ("files");
+
+    lazyLoading_ = settings.value ("lazyLoading").toBool(); // false by default
+    journal_ = settings.value ("journal").toBool(); // false by default
+    imageStore_ = settings.value ("imageStore").toBool(); // false by default
+    shrinkImages_ = settings.value ("shrinkImages").toBool(); // false by default
+    indexCache_ = settings.value ("indexCache").toBool(); // false by default
+    compressionLevel_ = qBound (0, settings.value ("compressionLevel", 1).toInt(), 9);
+    syncPolicy_ = qBound (static_cast<int>(SyncNever),
+                          settings.value ("syncPolicy", SyncOnSave).toInt(),
+                          static_cast<int>(SyncOnLeave));
+
+    settings.endGroup();
 }
 /*************************/
 void FN::writeGeometryConfig()
@@ -4640,10 +5615,28 @@ void FN::writeConfig()
     else if (timer_->isActive())
         timer_->stop();
 
+    settings.setValue ("editorLimit", editorLimit_);
+
     settings.setValue ("scrollJumpWorkaround", scrollJumpWorkaround_);
 
     settings.endGroup();
 
+    /*************
+     *** Files ***
+     *************/
+
+    settings.beginGroup ("files");
+
+    settings.setValue ("lazyLoading", lazyLoading_);
+    settings.setValue ("journal", journal_);
+    settings.setValue ("imageStore", imageStore_);
+    settings.setValue ("shrinkImages", shrinkImages_);
+    settings.setValue ("indexCache", indexCache_);
+    settings.setValue ("compressionLevel", compressionLevel_);
+    settings.setValue ("syncPolicy", syncPolicy_);
+
+    settings.endGroup();
+
     /*****************
      *** Shortcuts ***
      *****************/
@@ -4680,7 +5673,7 @@ void FN::txtPrint()
         else
         {
             fname = QFileInfo (xmlPath_).fileName();
-            if (fname.endsWith (".fnx"))
+            if (fname.endsWith (".fnx") || fname.endsWith (".fnb") || fname.endsWith (".fnd"))
                 fname.chop (4);
         }
     }
@@ -4715,12 +5708,11 @@ void FN::txtPrint()
             {
                 text.append (nodeAddress (indx));
                 DomItem *item = static_cast<DomItem*>(indx.internalPointer());
-                if (TextEdit *thisTextEdit = widgets_.value (item))
+                if (TextEdit *thisTextEdit = editorOf (item))
                     text.append (thisTextEdit->toHtml()); // the node text may have been edited
                 else
                 {
-                    QDomNodeList lst = item->node().childNodes();
-                    text.append (lst.item (0).nodeValue());
+                    text.append (item->text());
                 }
                 indx = model_->adjacentIndex (indx, true);
             }
@@ -4732,12 +5724,11 @@ void FN::txtPrint()
             {
                 text.append (nodeAddress (indx));
                 DomItem *item = static_cast<DomItem*>(indx.internalPointer());
-                if (TextEdit *thisTextEdit = widgets_.value (item))
+                if (TextEdit *thisTextEdit = editorOf (item))
                     text.append (thisTextEdit->toHtml());
                 else
                 {
-                    QDomNodeList lst = item->node().childNodes();
-                    text.append (lst.item (0).nodeValue());
+                    text.append (item->text());
                 }
                 indx = model_->adjacentIndex (indx, true);
             }
@@ -4745,6 +5736,7 @@ void FN::txtPrint()
         doc = new QTextDocument();
         newDocCreated = true;
         doc->setHtml (text);
+        model_->imageStore.addResources (doc, text);
     }
 
     if (dlg->exec() == QDialog::Accepted)
@@ -4846,7 +5838,16 @@ void FN::exportHTML()
     QTextDocument *doc = nullptr;
     bool newDocCreated = false;
     if (sel == 0)
+    {
         doc = qobject_cast< TextEdit *>(cw)->document();
+        if (!model_->imageStore.isEmpty())
+        { // an exported file should contain its images
+            const QString text = model_->imageStore.embedImages (doc->toHtml());
+            doc = new QTextDocument();
+            newDocCreated = true;
+            doc->setHtml (text);
+        }
+    }
     else
     {
         QString text;
@@ -4858,12 +5859,11 @@ void FN::exportHTML()
             {
                 text.append (nodeAddress (indx));
                 DomItem *item = static_cast<DomItem*>(indx.internalPointer());
-                if (TextEdit *thisTextEdit = widgets_.value (item))
+                if (TextEdit *thisTextEdit = editorOf (item))
                     text.append (thisTextEdit->toHtml()); // the node text may have been edited
                 else
                 {
-                    QDomNodeList lst = item->node().childNodes();
-                    text.append (lst.item (0).nodeValue());
+                    text.append (item->text());
                 }
                 indx = model_->adjacentIndex (indx, true);
             }
@@ -4875,19 +5875,18 @@ void FN::exportHTML()
             {
                 text.append (nodeAddress (indx));
                 DomItem *item = static_cast<DomItem*>(indx.internalPointer());
-                if (TextEdit *thisTextEdit = widgets_.value (item))
+                if (TextEdit *thisTextEdit = editorOf (item))
                     text.append (thisTextEdit->toHtml());
                 else
                 {
-                    QDomNodeList lst = item->node().childNodes();
-                    text.append (lst.item (0).nodeValue());
+                    text.append (item->text());
                 }
                 indx = model_->adjacentIndex (indx, true);
             }
         }
         doc = new QTextDocument();
         newDocCreated = true;
-        doc->setHtml (text);
+        doc->setHtml (model_->imageStore.embedImages (text));
     }
 
     QTextDocumentWriter writer (fname, "html");
@@ -4951,7 +5950,7 @@ void FN::setHTMLName (bool checked)
         else
         {
             fname = QFileInfo (xmlPath_).fileName();
-            if (fname.endsWith (".fnx"))
+            if (fname.endsWith (".fnx") || fname.endsWith (".fnb") || fname.endsWith (".fnd"))
                 fname.chop (4);
         }
     }
@@ -5166,7 +6165,7 @@ bool FN::isPswrdCorrect()
     bool res = true;
     switch (dialog->exec()) {
     case QDialog::Accepted:
-        if (pswrd_ != lineEdit->text())
+        if (encrypted_.isNull() ? pswrd_ != lineEdit->text() : decrypted_.isEmpty())
             res = false;
         delete dialog;
         break;
@@ -5202,7 +6201,16 @@ void FN::checkPswrd()
 
     listBtn.at (0)->setDefault (false); // don't interfere
 
-    if (listEdit.at (0)->text() != pswrd_)
+    bool correct;
+    if (encrypted_.isNull())
+        correct = (listEdit.at (0)->text() == pswrd_);
+    else
+    { // the password is correct if the encrypted file can be authenticated with it
+        QApplication::setOverrideCursor (Qt::WaitCursor);
+        correct = openedCipher_.decrypt (encrypted_, listEdit.at (0)->text(), decrypted_);
+        QApplication::restoreOverrideCursor();
+    }
+    if (!correct)
     {
         listLabel.at (0)->setText (tr ("<center>Wrong password. Retry!</center>"));
         listLabel.at (0)->setVisible (true);
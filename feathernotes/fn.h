@@ -22,9 +22,13 @@
 #include <QListWidgetItem>
 #include <QSystemTrayIcon>
 #include <QMainWindow>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <QSet>
 #include "textedit.h"
 #include "domitem.h"
 #include "lineedit.h"
+#include "fnxcipher.h"
 
 namespace FeatherNotes {
 
@@ -33,6 +37,17 @@ class FN;
 }
 
 class DomModel;
+class Notebook;
+
+/* a match listed by "Find All" */
+struct FindAllMatch
+{
+    QString text; // the matched text
+    int position; // in the plain text of the node
+    int ordinal; // the number of the same matches before it
+    int score; // the number of typos in a fuzzy match
+    QString snippet;
+};
 
 class FN : public QMainWindow
 {
@@ -173,11 +188,70 @@ public:
         autoSave_ = interval;
     }
 
+    int getEditorLimit() const {
+        return editorLimit_;
+    }
+    void setEditorLimit (int limit) {
+        editorLimit_ = limit; // will take effect when a new editor is created
+    }
+
     bool isScrollJumpWorkaroundEnabled() const {
         return scrollJumpWorkaround_;
     }
     void enableScrollJumpWorkaround (bool enable);
 
+    bool hasLazyLoading() const {
+        return lazyLoading_;
+    }
+    void setLazyLoading (bool lazy) {
+        lazyLoading_ = lazy; // will take effect with the next opened file
+    }
+
+    bool hasJournal() const {
+        return journal_;
+    }
+    void setJournal (bool journal) {
+        journal_ = journal;
+    }
+
+    bool hasImageStore() const {
+        return imageStore_;
+    }
+    void setImageStore (bool store);
+
+    bool hasIndexCache() const {
+        return indexCache_;
+    }
+    void setIndexCache (bool cache) {
+        indexCache_ = cache;
+    }
+
+    bool hasImageShrinking() const {
+        return shrinkImages_;
+    }
+    void setImageShrinking (bool shrink) {
+        shrinkImages_ = shrink;
+    }
+
+    int getCompressionLevel() const {
+        return compressionLevel_;
+    }
+    void setCompressionLevel (int level) {
+        compressionLevel_ = level;
+    }
+
+    enum SyncPolicy {
+        SyncNever = 0,
+        SyncOnSave,
+        SyncOnLeave
+    };
+    int getSyncPolicy() const {
+        return syncPolicy_;
+    }
+    void setSyncPolicy (int policy) {
+        syncPolicy_ = policy;
+    }
+
     void updateCustomizableShortcuts();
 
     QHash<QString, QString> customShortcutActions() const {
@@ -226,6 +300,8 @@ private slots:
     void txtContextMenu (const QPoint &p);
     void copyLink();
     void selChanged (const QItemSelection &selected, const QItemSelection&);
+    void prefetchDocs();
+    void endPreview();
     void setSaveEnabled (bool modified);
     void setUndoEnabled (bool enabled);
     void setRedoEnabled (bool enabled);
@@ -276,6 +352,7 @@ private slots:
     void toggleIndent();
     void prefDialog();
     void noteModified();
+    void autoSaved();
     void docProp();
     void nodeChanged (const QModelIndex&, const QModelIndex&);
     void showHideSearch();
@@ -285,10 +362,17 @@ private slots:
     void find();
     void hlight() const;
     void scrolled (int) const;
+    void scheduleHlight() const;
     void setSearchFlags();
     void allBtn (bool checked);
     void tagsAndNamesBtn (bool checked);
+    void patternBtn (bool checked);
     void replaceDock();
+    void findAll();
+    void findAllResultReady (int index);
+    void findAllFinished();
+    void cancelFindAll();
+    void findAllActivated (QListWidgetItem *item);
     void closeReplaceDock (bool visible);
     void resizeDock (bool topLevel);
     void replace();
@@ -310,23 +394,43 @@ private slots:
 
 private:
     void enableActions (bool enable);
+    void enableEditorActions (bool enable);
     void fileOpen (const QString &filePath);
-    bool fileSave (const QString &filePath);
+    bool fileSave (const QString &filePath, bool full = false);
+    void compactJournal();
+    void leaveDocument();
+    bool canJournal() const;
+    bool saveNotebook (const QString &filePath);
+    void markSaved();
+    void waitForAutoSave();
+    QString imageSource (const QByteArray &data);
+    QString imageHtml (const QByteArray &data, int w, int h);
     void createTrayIcon();
     void closeEvent (QCloseEvent *event);
     void resizeEvent (QResizeEvent *event);
     void showEvent (QShowEvent *event);
-    void showDoc (QDomDocument &doc);
+    void showDoc (DomModel *newModel);
+    void cachePlainTexts();
     void setTitle (const QString& fname);
     void notSaved();
-    void setNodesTexts();
+    QList<DomItem*> setNodesTexts();
+    void countModification();
     bool unSaved (bool modified);
-    TextEdit *newWidget();
+    TextEdit *newWidget (QTextDocument *doc = nullptr);
+    void removeWidget (DomItem *item);
+    void closeOldWidgets();
+    QString editorsInfo() const;
     void mergeFormatOnWordOrSelection (const QTextCharFormat &format);
     void setNewFont (DomItem *item, QTextCharFormat &fmt);
     QTextCursor finding (const QString& str,
                          const QTextCursor& start,
                          QTextDocument::FindFlags flags) const;
+    static QTextCursor finding (QTextDocument *txtdoc,
+                                const QString& str,
+                                const QTextCursor& start,
+                                QTextDocument::FindFlags flags);
+    void updateTextIndex();
+    bool nodeContains (DomItem *item, const QString &str, Qt::CaseSensitivity cs) const;
     void findInTags();
     void reallySetSearchFlags (bool h);
     void findInNames();
@@ -348,22 +452,74 @@ private:
     bool quitting_;
     int trayCounter_; // Used when waiting for the system tray to be created at startup.
     int saveNeeded_;
+    bool structureModified_; // Is there a change that can't be journaled since the last full save?
     QFont defaultFont_, nodeFont_;
     QColor lastTxtColor_, lastBgColor_;
     DomModel *model_;
     QString xmlPath_;
     LineEdit *ImagePathEntry_, *htmlPahEntry_;
-    /* By pairing each widget with a DOM item, we won't need to worry
-       about keeping the correspondence between widgets and nodes: */
-    QHash<DomItem*,TextEdit*> widgets_;
+    /* Everything kept for a node that is shown. By pairing each editor with
+       a DOM item, we won't need to worry about keeping the correspondence
+       between editors and nodes: */
+    struct NodeSession
+    {
+        NodeSession() : editor (nullptr), scrollPos (0) {}
+        TextEdit *editor; // Null if the editor is closed to save memory.
+        QString searchEntry;
+        QList<QTextEdit::ExtraSelection> greenSels; // For replaced matches.
+        /* The positions of the matches of the search text, found once
+           for every revision of the document and used by hlight(): */
+        struct MatchCache
+        {
+            MatchCache() : revision (-1) {}
+            int revision;
+            QString text;
+            QTextDocument::FindFlags flags;
+            QVector<QPair<int, int> > matches; // (start, end) of each match, in order
+        };
+        mutable MatchCache matchCache;
+        int scrollPos; // The vertical scroll position of a closed editor.
+    };
+    QHash<DomItem*, NodeSession> sessions_;
+    DomItem *currentNode_; // The node whose editor is shown.
+    TextEdit *editorOf (DomItem *item) const;
+    NodeSession *currentSession();
+    const NodeSession *currentSession() const;
+    void clearSearches();
+    void removeGreenSels();
+    int replaceAllInWidget (NodeSession &session);
+    int replaceAllInNode (DomItem *item);
+    /* The documents of the nodes around the current one, which are made in
+       other threads before they're shown, with the generations of the texts
+       they're made from: */
+    struct PrefetchedDoc
+    {
+        QTextDocument *doc;
+        quint32 generation;
+    };
+    QHash<DomItem*, PrefetchedDoc> prefetchedDocs_;
+    QTimer *prefetchTimer_; // Waits for the selection to settle.
+    bool prefetching_;
+    QTextDocument *takePrefetchedDoc (DomItem *item);
+    void discardPrefetchedDocs();
+    /* While nodes are passed quickly, a read-only editor shows their texts: */
+    TextEdit *previewEdit_;
+    QTimer *editorTimer_; // Creates the editor of the previewed node when the selection rests.
+    QElapsedTimer lastSelChange_;
+    void previewNode (DomItem *item);
+    /* The nodes whose texts are changed without widgets since the last saving: */
+    QSet<DomItem*> changedTexts_;
     QTextDocument::FindFlags searchFlags_; // Whole word and case sensitivity flags.
-    QHash<TextEdit*,QString> searchEntries_; // Search entries, one for each QTextEdit.
     bool searchingOtherNode_; // Needed when jumping to another node during search.
     bool rplOtherNode_; // Like above but for replacement.
-    int replCount_; // Needed for counting replacements in all nodes.
-    QHash<TextEdit*,QList<QTextEdit::ExtraSelection> > greenSels_; // For replaced matches.
+    QTimer *hlightTimer_; // Coalesces scrolling and resizing into one highlighting per frame.
     QString txtReplace_; // The replacing text.
     QModelIndexList tagsList_;
+    /* "Find All" searches node texts in other threads. Each result has
+       the matches in a node of findAllNodes_. */
+    QFutureWatcher<QVector<FindAllMatch> > *findAllWatcher_;
+    QList<QPersistentModelIndex> findAllNodes_;
+    QTextDocument::FindFlags findAllFlags_;
     QString linkAtPos_; // Text hyperlink at the right-click position.
     QTextTable *txtTable_; // Text table at the right-click position.
     int imgScale_; QString lastImgPath_;
@@ -382,13 +538,29 @@ private:
          autoReplace_,
          treeViewDND_;
     int autoSave_;
+    int editorLimit_; // The maximum number of node editors, or -1 for no limit.
+    QList<DomItem*> recentNodes_; // The nodes with editors, from the least recently shown.
+    int closedWidgets_; // The number of editors that are closed to save memory.
     QPoint position_; // Excluding the window frame.
     QSize winSize_, startSize_, prefSize_;
     //QList<int> splitterSizes_;
     QByteArray splitterSizes_;
     QTimer *timer_;
+    QFutureWatcher<bool> *autoSaver_; // Auto-saving is done in another thread.
+    bool autoSavePending_; // Is the result of the last auto-saving not handled yet?
     QString pswrd_;
+    FnxCipher cipher_; // Keeps the keys of the password for saving.
+    QByteArray encrypted_, decrypted_; // Used while the password of an encrypted file is asked.
+    FnxCipher openedCipher_;
+    QSharedPointer<Notebook> notebook_; // Set if the document is kept in a notebook.
     bool scrollJumpWorkaround_; // Should a workaround for Qt5's "scroll jump" bug be applied?
+    bool lazyLoading_; // Should node texts be read from the mapped file only when needed?
+    bool journal_; // Should changed node texts be appended to a journal instead of saving the whole file?
+    bool imageStore_; // Should new images be stored once per document instead of inside node texts?
+    bool shrinkImages_; // Should images be re-encoded with their smaller embedding sizes?
+    bool indexCache_; // Should the search index be kept beside the document?
+    int syncPolicy_; // When should saved files be flushed to disk?
+    int compressionLevel_; // The zlib level of encrypted documents (0 for no compression).
     bool underE_; // Is FeatherNotes running under Enlightenment?
     QSize EShift_; // The shift Enlightenment's panel creates (a bug?).
     QHash<QString, QString> customActions_;
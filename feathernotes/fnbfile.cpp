@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QFile>
+#include <QDataStream>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QSet>
+#include <cstring>
+#include "fnbfile.h"
+
+namespace FeatherNotes {
+
+static const char fnbMagic[4] = {'F', 'N', 'B', '\0'};
+static const quint32 fnbVersion = 1;
+static const qint64 headerSize = 8;
+static const qint64 trailerSize = 20;
+
+enum BodyCodec {
+    NoBody = 0,
+    Utf8 = 1,
+    ZlibUtf8 = 2
+};
+
+/* compressing short texts wouldn't save much */
+static const int minCompressedSize = 512;
+
+/*************************/
+// An FNB document mapped into memory or decrypted. Texts are decoded only when they are requested.
+class FnbSource : public TextSource
+{
+public:
+    FnbSource (const QString &filePath) : file_ (filePath), mapped_ (nullptr), data_ (nullptr), size_ (0) {
+        if (file_.open (QIODevice::ReadOnly))
+        {
+            size_ = file_.size();
+            if (size_ > 0)
+            {
+                mapped_ = file_.map (0, size_);
+                data_ = reinterpret_cast<const char*>(mapped_);
+            }
+        }
+    }
+    FnbSource (const QByteArray &data) : bytes_ (data), mapped_ (nullptr),
+                                         data_ (bytes_.constData()), size_ (bytes_.size()) {}
+    ~FnbSource() {
+        if (mapped_)
+            file_.unmap (mapped_);
+    }
+
+    bool isValid() const {
+        return data_ != nullptr;
+    }
+    const char *data() const {
+        return data_;
+    }
+    qint64 size() const {
+        return size_;
+    }
+
+    /* should be called only before the source is shared */
+    void setCompressed (qint64 offset) {
+        compressed_.insert (offset);
+    }
+
+    QString text (qint64 offset, qint64 length) const {
+        if (offset < 0 || length <= 0 || offset + length > size_)
+            return QString();
+        if (compressed_.contains (offset))
+        {
+            return QString::fromUtf8 (qUncompress (reinterpret_cast<const uchar*>(data_ + offset),
+                                                   static_cast<int>(length)));
+        }
+        return QString::fromUtf8 (data_ + offset, static_cast<int>(length));
+    }
+
+    /* the stored bytes aren't copied; the source outlives the document snapshots */
+    QByteArray fnbBody (qint64 offset, qint64 length, bool &compressed) const {
+        if (offset < 0 || length <= 0 || offset + length > size_)
+            return QByteArray();
+        compressed = compressed_.contains (offset);
+        return QByteArray::fromRawData (data_ + offset, static_cast<int>(length));
+    }
+
+private:
+    QFile file_;
+    QByteArray bytes_;
+    uchar *mapped_;
+    const char *data_;
+    qint64 size_;
+    QSet<qint64> compressed_;
+};
+
+/*************************/
+bool FnbReader::isFnb (QIODevice *device)
+{
+    return isFnb (device->peek (4));
+}
+/*************************/
+bool FnbReader::isFnb (const QByteArray &data)
+{
+    return data.size() >= 4 && std::memcmp (data.constData(), fnbMagic, 4) == 0;
+}
+/*************************/
+// Builds the DOM tree from the table. The bodies of nodes aren't touched
+// but the stored images are put into the tree, where DomModel finds them.
+static bool readTable (FnbSource &source, QDomDocument &doc,
+                       QVector<TextRange> &ranges, QString &error)
+{
+    const char *data = source.data();
+    const qint64 size = source.size();
+    if (size < headerSize + trailerSize
+        || std::memcmp (data, fnbMagic, 4) != 0
+        || std::memcmp (data + size - 4, fnbMagic, 4) != 0)
+    {
+        error = "Not an FNB document.";
+        return false;
+    }
+
+    quint32 version = 0;
+    QDataStream header (QByteArray::fromRawData (data + 4, 4));
+    header >> version;
+    if (version == 0 || version > fnbVersion)
+    {
+        error = "Unsupported FNB version.";
+        return false;
+    }
+
+    qint64 tableOffset = 0, tableLength = 0;
+    QDataStream trailer (QByteArray::fromRawData (data + size - trailerSize, trailerSize - 4));
+    trailer >> tableOffset >> tableLength;
+    if (tableOffset < headerSize || tableLength <= 0
+        || tableOffset + tableLength > size - trailerSize)
+    {
+        error = "Invalid table offset.";
+        return false;
+    }
+    const qint64 bodiesEnd = tableOffset;
+    auto isInBodies = [bodiesEnd] (qint64 offset, qint64 length) {
+        return offset >= headerSize && length >= 0 && offset + length <= bodiesEnd;
+    };
+
+    QDataStream in (QByteArray::fromRawData (data + tableOffset, static_cast<int>(tableLength)));
+    in.setVersion (QDataStream::Qt_5_0);
+
+    QDomElement root = doc.createElement ("feathernotes");
+    doc.appendChild (root);
+    quint32 count = 0;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        QString name, value;
+        in >> name >> value;
+        root.setAttribute (name, value);
+    }
+
+    in >> count;
+    QVector<QDomElement> nodes;
+    QVector<qint32> ancestors;
+    for (quint32 i = 0; i < count; ++i)
+    {
+        qint32 parent = -1;
+        QString name, tag, icon;
+        quint32 attrCount = 0;
+        in >> parent >> name >> tag >> icon >> attrCount;
+        QDomElement e = doc.createElement ("node");
+        if (!name.isNull())
+            e.setAttribute ("name", name);
+        if (!tag.isNull())
+            e.setAttribute ("tag", tag);
+        if (!icon.isNull())
+            e.setAttribute ("icon", icon);
+        for (quint32 j = 0; j < attrCount && in.status() == QDataStream::Ok; ++j)
+        {
+            QString attrName, attrValue;
+            in >> attrName >> attrValue;
+            e.setAttribute (attrName, attrValue);
+        }
+        qint64 offset = 0, length = 0;
+        quint8 codec = NoBody;
+        in >> offset >> length >> codec;
+        if (in.status() != QDataStream::Ok)
+        {
+            error = "Unexpected end of the node table.";
+            return false;
+        }
+
+        /* the nodes are in pre-order; so, the parent should be an open ancestor */
+        while (!ancestors.isEmpty() && ancestors.last() != parent)
+            ancestors.removeLast();
+        if (parent >= 0 && ancestors.isEmpty())
+        {
+            error = "Invalid node parent.";
+            return false;
+        }
+        QDomElement parentElement = parent >= 0 ? nodes.at (parent) : root;
+        parentElement.appendChild (e);
+        ancestors << static_cast<qint32>(i);
+        nodes << e;
+
+        TextRange range;
+        range.offset = -1;
+        range.length = 0;
+        if (codec != NoBody && length > 0)
+        {
+            if (codec > ZlibUtf8 || !isInBodies (offset, length))
+            {
+                error = "Invalid node body.";
+                return false;
+            }
+            range.offset = offset;
+            range.length = length;
+            if (codec == ZlibUtf8)
+                source.setCompressed (offset);
+        }
+        ranges << range;
+    }
+
+    in >> count;
+    if (count > 0 && in.status() == QDataStream::Ok)
+    {
+        QDomElement images = doc.createElement ("images");
+        for (quint32 i = 0; i < count; ++i)
+        {
+            QString id;
+            qint64 offset = 0, length = 0;
+            in >> id >> offset >> length;
+            if (in.status() != QDataStream::Ok || !isInBodies (offset, length))
+            {
+                error = "Invalid image.";
+                return false;
+            }
+            QDomElement e = doc.createElement ("image");
+            e.setAttribute ("id", id);
+            const QByteArray raw = QByteArray::fromRawData (data + offset, static_cast<int>(length));
+            e.appendChild (doc.createTextNode (QString::fromLatin1 (raw.toBase64())));
+            images.appendChild (e);
+        }
+        root.appendChild (images);
+    }
+
+    if (in.status() != QDataStream::Ok)
+    {
+        error = "Unexpected end of the table.";
+        return false;
+    }
+    return true;
+}
+/*************************/
+bool FnbReader::read (const QString &filePath, QDomDocument &doc,
+                      QSharedPointer<TextSource> &source, QVector<TextRange> &ranges)
+{
+    errorString_.clear();
+    ranges.clear();
+    QSharedPointer<FnbSource> fnbSource (new FnbSource (filePath));
+    if (!fnbSource->isValid())
+    {
+        errorString_ = "The file could not be mapped into memory.";
+        return false;
+    }
+    if (!readTable (*fnbSource, doc, ranges, errorString_))
+    {
+        doc = QDomDocument();
+        ranges.clear();
+        return false;
+    }
+    source = fnbSource;
+    return true;
+}
+/*************************/
+bool FnbReader::read (const QByteArray &data, QDomDocument &doc,
+                      QSharedPointer<TextSource> &source, QVector<TextRange> &ranges)
+{
+    errorString_.clear();
+    ranges.clear();
+    QSharedPointer<FnbSource> fnbSource (new FnbSource (data));
+    if (!readTable (*fnbSource, doc, ranges, errorString_))
+    {
+        doc = QDomDocument();
+        ranges.clear();
+        return false;
+    }
+    source = fnbSource;
+    return true;
+}
+
+/*************************/
+// Finds the images of the store that are referenced in a node text.
+static void findImages (const QString &text, QSet<QString> &ids)
+{
+    static const QRegularExpression ref ("fnimg:([0-9a-f]+)");
+    QRegularExpressionMatchIterator it = ref.globalMatch (text);
+    while (it.hasNext())
+        ids.insert (it.next().captured (1));
+}
+/*************************/
+// The same for the UTF-8 bytes of a stored body.
+static void findImages (const QByteArray &body, QSet<QString> &ids)
+{
+    static const QByteArray scheme ("fnimg:");
+    int from = 0, idx;
+    while ((idx = body.indexOf (scheme, from)) != -1)
+    {
+        int end = idx + scheme.size();
+        while (end < body.size()
+               && ((body.at (end) >= '0' && body.at (end) <= '9')
+                   || (body.at (end) >= 'a' && body.at (end) <= 'f')))
+        {
+            ++end;
+        }
+        if (end > idx + scheme.size())
+            ids.insert (QString::fromLatin1 (body.constData() + idx + scheme.size(), end - idx - scheme.size()));
+        from = end;
+    }
+}
+/*************************/
+// The bodies are written while the table is made in the memory. The bodies
+// of untouched nodes of an FNB document are copied without being decoded.
+bool FnbWriter::write (const FnxSnapshot &snapshot, QIODevice *device)
+{
+    QDataStream out (device);
+    out.setVersion (QDataStream::Qt_5_0);
+    if (device->write (fnbMagic, 4) != 4)
+        return false;
+    out << fnbVersion;
+    qint64 pos = headerSize;
+
+    QByteArray table;
+    QDataStream t (&table, QIODevice::WriteOnly);
+    t.setVersion (QDataStream::Qt_5_0);
+    t << static_cast<quint32>(snapshot.rootAttributes.size());
+    for (const auto &attr : snapshot.rootAttributes)
+        t << attr.first << attr.second;
+
+    t << static_cast<quint32>(snapshot.nodes.size());
+    /* the open ancestors, with the numbers of their remaining children */
+    QVector<QPair<qint32, int> > open;
+    QSet<QString> images;
+    for (int i = 0; i < snapshot.nodes.size(); ++i)
+    {
+        const FnxSnapshot::Node &node = snapshot.nodes.at (i);
+        while (!open.isEmpty() && open.last().second == 0)
+            open.removeLast();
+        qint32 parent = -1;
+        if (!open.isEmpty())
+        {
+            parent = open.last().first;
+            --open.last().second;
+        }
+        open << qMakePair (static_cast<qint32>(i), node.childCount);
+
+        QString name, tag, icon;
+        QVector<QPair<QString, QString> > others;
+        for (const auto &attr : node.attributes)
+        {
+            if (attr.first == "name")
+                name = attr.second.isNull() ? QString ("") : attr.second;
+            else if (attr.first == "tag")
+                tag = attr.second.isNull() ? QString ("") : attr.second;
+            else if (attr.first == "icon")
+                icon = attr.second.isNull() ? QString ("") : attr.second;
+            else
+                others << attr;
+        }
+
+        quint8 codec = NoBody;
+        qint64 offset = 0, length = 0;
+        QByteArray body;
+        if (node.source)
+        {
+            bool compressed = false;
+            body = node.source->fnbBody (node.range.offset, node.range.length, compressed);
+            if (!body.isNull())
+            {
+                codec = compressed ? ZlibUtf8 : Utf8;
+                /* a compressed body is decompressed only if images may be referenced in it */
+                if (!snapshot.images.isEmpty())
+                    findImages (compressed ? qUncompress (body) : body, images);
+            }
+        }
+        if (body.isNull())
+        {
+            const QString txt = node.source ? node.source->text (node.range.offset, node.range.length)
+                                            : node.text;
+            if (!txt.isEmpty())
+            {
+                findImages (txt, images);
+                body = txt.toUtf8();
+                codec = Utf8;
+                if (body.size() >= minCompressedSize)
+                {
+                    QByteArray compressed = qCompress (body);
+                    if (compressed.size() < body.size())
+                    {
+                        body.swap (compressed);
+                        codec = ZlibUtf8;
+                    }
+                }
+            }
+        }
+        if (codec != NoBody)
+        {
+            if (device->write (body) != body.size())
+                return false;
+            offset = pos;
+            length = body.size();
+            pos += length;
+        }
+
+        t << parent << name << tag << icon << static_cast<quint32>(others.size());
+        for (const auto &attr : others)
+            t << attr.first << attr.second;
+        t << offset << length << codec;
+    }
+
+    /* only the referenced images are written, in a fixed order */
+    QStringList ids;
+    for (const QString &id : images)
+    {
+        if (snapshot.images.contains (id))
+            ids << id;
+    }
+    ids.sort();
+    t << static_cast<quint32>(ids.size());
+    for (const QString &id : ids)
+    {
+        const QByteArray raw = QByteArray::fromBase64 (snapshot.images.value (id));
+        if (device->write (raw) != raw.size())
+            return false;
+        t << id << pos << static_cast<qint64>(raw.size());
+        pos += raw.size();
+    }
+
+    if (t.status() != QDataStream::Ok
+        || device->write (table) != table.size())
+    {
+        return false;
+    }
+    out << pos << static_cast<qint64>(table.size());
+    if (device->write (fnbMagic, 4) != 4)
+        return false;
+    return out.status() == QDataStream::Ok;
+}
+
+}
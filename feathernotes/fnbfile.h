@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FNBFILE_H
+#define FNBFILE_H
+
+#include <QIODevice>
+#include <QDomDocument>
+#include <QSharedPointer>
+#include <QVector>
+#include "textsource.h"
+#include "fnxwriter.h"
+
+namespace FeatherNotes {
+
+/* The FNB format is a binary alternative to FNX, in which node texts are kept
+   apart from the tree of nodes. Its numbers are big-endian and its strings
+   are serialized by QDataStream (version Qt_5_0):
+
+       header:   "FNB\0" (4 bytes), format version (quint32)
+       bodies:   the node texts, each UTF-8 or zlib-compressed UTF-8,
+                 and the raw data of the stored images
+       table:    root attributes (quint32 count, then name/value pairs),
+                 quint32 node count, then for each node in pre-order:
+                 parent (qint32, -1 for top-level nodes), name, tag, icon
+                 (null strings for missing attributes), other attributes,
+                 body offset (qint64), body length (qint64), codec (quint8);
+                 quint32 image count, then for each image: id, data offset
+                 (qint64), data length (qint64)
+       trailer:  table offset (qint64), table length (qint64), "FNB\0"
+
+   The trailer comes last so that the file can be written in one pass.
+   A node is identified by its index in the table. */
+
+// Reads the table of an FNB document into a DOM tree. Node texts are left
+// in the file, which is mapped into memory, and decoded only when needed.
+class FnbReader
+{
+public:
+    /* whether the device contains an FNB document */
+    static bool isFnb (QIODevice *device);
+    static bool isFnb (const QByteArray &data);
+
+    bool read (const QString &filePath, QDomDocument &doc,
+               QSharedPointer<TextSource> &source, QVector<TextRange> &ranges);
+    /* for decrypted documents, whose texts are read from the memory */
+    bool read (const QByteArray &data, QDomDocument &doc,
+               QSharedPointer<TextSource> &source, QVector<TextRange> &ranges);
+
+    QString errorString() const {
+        return errorString_;
+    }
+
+private:
+    QString errorString_;
+};
+
+// Writes a document snapshot as an FNB document.
+class FnbWriter
+{
+public:
+    /* the device should be opened for writing */
+    static bool write (const FnxSnapshot &snapshot, QIODevice *device);
+};
+
+}
+
+#endif // FNBFILE_H
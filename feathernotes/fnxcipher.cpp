@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCryptographicHash>
+#include <QMessageAuthenticationCode>
+#include <QtEndian>
+#include <string.h>
+#include "fnxcipher.h"
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5,10,0))
+#include <QRandomGenerator>
+#else
+#include <QFile>
+#include <QDateTime>
+#endif
+
+namespace FeatherNotes {
+
+static const char MAGIC[] = "FNXE";
+static const int MAGIC_SIZE = 4;
+static const quint8 VERSION = 1;
+static const quint8 FLAG_COMPRESSED = 0x01;
+static const int SALT_SIZE = 16;
+static const int NONCE_SIZE = 12;
+static const int HEADER_SIZE = MAGIC_SIZE + 4 + 4 + SALT_SIZE + NONCE_SIZE;
+static const int TAG_SIZE = 32;
+static const quint32 DEFAULT_ITERATIONS = 100000;
+/* a corrupt or crafted header shouldn't keep the key derivation busy for minutes */
+static const quint32 MAX_ITERATIONS = 10 * DEFAULT_ITERATIONS;
+/* bytes that are authenticated and encrypted at once (a multiple of 64) */
+static const int CHUNK_SIZE = 65536;
+
+static QByteArray randomBytes (int size)
+{
+    QByteArray res (size, Qt::Uninitialized);
+#if (QT_VERSION >= QT_VERSION_CHECK(5,10,0))
+    for (int i = 0; i < size; i += 4)
+    {
+        const quint32 r = QRandomGenerator::system()->generate();
+        memcpy (res.data() + i, &r, static_cast<size_t>(qMin (4, size - i)));
+    }
+#else
+    QFile file ("/dev/urandom");
+    if (!file.open (QIODevice::ReadOnly) || file.read (res.data(), size) != size)
+    { // not a good randomness but the salt and nonce only need to be unique
+        qsrand (static_cast<uint>(QDateTime::currentMSecsSinceEpoch()));
+        for (int i = 0; i < size; ++i)
+            res[i] = static_cast<char>(qrand() & 0xff);
+    }
+#endif
+    return res;
+}
+/*************************/
+// Compresses a few samples quickly to see whether compressing the data is worthwhile.
+static bool isCompressible (const QByteArray &data)
+{
+    static const int minSize = 1024;
+    static const int sampleSize = 16384;
+    static const int samples = 4;
+    if (data.size() < minSize)
+        return false;
+    QByteArray sample;
+    if (data.size() <= samples * sampleSize)
+        sample = data;
+    else
+    {
+        const int step = (data.size() - sampleSize) / (samples - 1);
+        for (int i = 0; i < samples; ++i)
+            sample.append (data.constData() + i * step, sampleSize);
+    }
+    /* Base64 and already compressed data don't shrink much */
+    const int compressed = qCompress (sample, 1).size() - 4; // without the size prefix
+    return compressed < sample.size() * 4 / 5;
+}
+/*************************/
+// PBKDF2-HMAC-SHA256 with a single output block (32 bytes).
+static QByteArray pbkdf2 (const QByteArray &password, const QByteArray &salt, quint32 iterations)
+{
+    QMessageAuthenticationCode mac (QCryptographicHash::Sha256, password);
+    QByteArray u = salt;
+    u.append ('\0').append ('\0').append ('\0').append ('\1'); // block index 1
+    mac.addData (u);
+    u = mac.result();
+    QByteArray res = u;
+    char *r = res.data();
+    for (quint32 i = 1; i < iterations; ++i)
+    {
+        mac.reset();
+        mac.addData (u);
+        u = mac.result();
+        const char *p = u.constData();
+        for (int j = 0; j < 32; ++j)
+            r[j] ^= p[j];
+    }
+    return res;
+}
+/*************************/
+static inline quint32 rotl (quint32 v, int c)
+{
+    return (v << c) | (v >> (32 - c));
+}
+
+#define QUARTERROUND(a, b, c, d) \
+    a += b; d ^= a; d = rotl (d, 16); \
+    c += d; b ^= c; b = rotl (b, 12); \
+    a += b; d ^= a; d = rotl (d, 8); \
+    c += d; b ^= c; b = rotl (b, 7);
+
+// The ChaCha20 cipher of RFC 8439, applied in place.
+class ChaCha20
+{
+public:
+    ChaCha20 (const QByteArray &key, const QByteArray &nonce) {
+        state_[0] = 0x61707865; state_[1] = 0x3320646e;
+        state_[2] = 0x79622d32; state_[3] = 0x6b206574;
+        const uchar *k = reinterpret_cast<const uchar*>(key.constData());
+        for (int i = 0; i < 8; ++i)
+            state_[4 + i] = qFromLittleEndian<quint32>(k + 4 * i);
+        state_[12] = 0; // the block counter
+        const uchar *n = reinterpret_cast<const uchar*>(nonce.constData());
+        for (int i = 0; i < 3; ++i)
+            state_[13 + i] = qFromLittleEndian<quint32>(n + 4 * i);
+    }
+
+    /* should be called with multiples of 64 bytes, except for the last time */
+    void apply (char *data, int size) {
+        uchar stream[64];
+        while (size > 0)
+        {
+            nextBlock (stream);
+            const int n = qMin (size, 64);
+            for (int i = 0; i < n; ++i)
+                data[i] ^= static_cast<char>(stream[i]);
+            data += n;
+            size -= n;
+        }
+    }
+
+private:
+    void nextBlock (uchar out[64]) {
+        quint32 x[16];
+        memcpy (x, state_, sizeof (x));
+        for (int i = 0; i < 10; ++i)
+        {
+            QUARTERROUND (x[0], x[4], x[8], x[12])
+            QUARTERROUND (x[1], x[5], x[9], x[13])
+            QUARTERROUND (x[2], x[6], x[10], x[14])
+            QUARTERROUND (x[3], x[7], x[11], x[15])
+            QUARTERROUND (x[0], x[5], x[10], x[15])
+            QUARTERROUND (x[1], x[6], x[11], x[12])
+            QUARTERROUND (x[2], x[7], x[8], x[13])
+            QUARTERROUND (x[3], x[4], x[9], x[14])
+        }
+        for (int i = 0; i < 16; ++i)
+            qToLittleEndian<quint32>(x[i] + state_[i], out + 4 * i);
+        ++state_[12];
+    }
+
+    quint32 state_[16];
+};
+/*************************/
+FnxCipher::FnxCipher() : iterations_ (DEFAULT_ITERATIONS), compressionLevel_ (0) {}
+/*************************/
+bool FnxCipher::isEncrypted (QIODevice *device)
+{
+    return device->peek (MAGIC_SIZE) == QByteArray (MAGIC, MAGIC_SIZE);
+}
+/*************************/
+void FnxCipher::deriveKeys (const QString &password, const QByteArray &salt, quint32 iterations)
+{
+    const QByteArray master = pbkdf2 (password.toUtf8(), salt, iterations);
+    encKey_ = QMessageAuthenticationCode::hash ("encryption", master, QCryptographicHash::Sha256);
+    macKey_ = QMessageAuthenticationCode::hash ("authentication", master, QCryptographicHash::Sha256);
+    password_ = password;
+    salt_ = salt;
+    iterations_ = iterations;
+}
+/*************************/
+void FnxCipher::setPassword (const QString &password)
+{
+    if (password != password_ || encKey_.isEmpty())
+        deriveKeys (password, randomBytes (SALT_SIZE), DEFAULT_ITERATIONS);
+}
+/*************************/
+QByteArray FnxCipher::encrypt (const QByteArray &plain) const
+{
+    if (encKey_.isEmpty()) return QByteArray();
+
+    quint8 flags = 0;
+    QByteArray payload = plain;
+    if (compressionLevel_ > 0 && isCompressible (plain))
+    {
+        QByteArray compressed = qCompress (plain, compressionLevel_);
+        if (compressed.size() < plain.size())
+        {
+            payload = compressed;
+            flags |= FLAG_COMPRESSED;
+        }
+    }
+
+    const QByteArray nonce = randomBytes (NONCE_SIZE);
+    QByteArray res;
+    res.reserve (HEADER_SIZE + payload.size() + TAG_SIZE);
+    res.append (MAGIC, MAGIC_SIZE);
+    res.append (static_cast<char>(VERSION)).append (static_cast<char>(flags)).append ('\0').append ('\0');
+    uchar it[4];
+    qToLittleEndian<quint32>(iterations_, it);
+    res.append (reinterpret_cast<const char*>(it), 4);
+    res.append (salt_);
+    res.append (nonce);
+    res.append (payload);
+
+    QMessageAuthenticationCode mac (QCryptographicHash::Sha256, macKey_);
+    mac.addData (res.constData(), HEADER_SIZE);
+    ChaCha20 chacha (encKey_, nonce);
+    char *data = res.data() + HEADER_SIZE;
+    for (int i = 0; i < payload.size(); i += CHUNK_SIZE)
+    { // authenticate each chunk while it's in the cache
+        const int n = qMin (CHUNK_SIZE, payload.size() - i);
+        chacha.apply (data + i, n);
+        mac.addData (data + i, n);
+    }
+    res.append (mac.result());
+    return res;
+}
+/*************************/
+bool FnxCipher::decrypt (const QByteArray &data, const QString &password, QByteArray &plain)
+{
+    if (data.size() < HEADER_SIZE + TAG_SIZE
+        || !data.startsWith (QByteArray (MAGIC, MAGIC_SIZE))
+        || static_cast<quint8>(data.at (MAGIC_SIZE)) != VERSION)
+    {
+        return false;
+    }
+    const uchar *header = reinterpret_cast<const uchar*>(data.constData());
+    const quint8 flags = header[MAGIC_SIZE + 1];
+    if ((flags & ~FLAG_COMPRESSED) != 0) return false;
+    const quint32 iterations = qFromLittleEndian<quint32>(header + MAGIC_SIZE + 4);
+    if (iterations == 0 || iterations > MAX_ITERATIONS) return false;
+    const QByteArray salt = data.mid (MAGIC_SIZE + 8, SALT_SIZE);
+    const QByteArray nonce = data.mid (MAGIC_SIZE + 8 + SALT_SIZE, NONCE_SIZE);
+
+    FnxCipher cipher;
+    if (password == password_ && salt == salt_ && iterations == iterations_ && !encKey_.isEmpty())
+        cipher = *this;
+    else
+        cipher.deriveKeys (password, salt, iterations);
+
+    /* decrypt and authenticate in a single pass but
+       use the result only if the data is authentic */
+    const int size = data.size() - HEADER_SIZE - TAG_SIZE;
+    QByteArray res (data.constData() + HEADER_SIZE, size);
+    QMessageAuthenticationCode mac (QCryptographicHash::Sha256, cipher.macKey_);
+    mac.addData (data.constData(), HEADER_SIZE);
+    ChaCha20 chacha (cipher.encKey_, nonce);
+    char *p = res.data();
+    for (int i = 0; i < size; i += CHUNK_SIZE)
+    {
+        const int n = qMin (CHUNK_SIZE, size - i);
+        mac.addData (p + i, n);
+        chacha.apply (p + i, n);
+    }
+
+    /* compare in constant time */
+    const QByteArray tag = mac.result();
+    const char *expected = data.constData() + HEADER_SIZE + size;
+    char diff = 0;
+    for (int i = 0; i < TAG_SIZE; ++i)
+        diff |= tag.at (i) ^ expected[i];
+    if (diff != 0)
+        return false;
+
+    if (flags & FLAG_COMPRESSED)
+    {
+        res = qUncompress (res);
+        if (res.isEmpty()) return false;
+    }
+
+    plain = res;
+    cipher.compressionLevel_ = compressionLevel_;
+    *this = cipher;
+    return true;
+}
+
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FNXCIPHER_H
+#define FNXCIPHER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QIODevice>
+
+namespace FeatherNotes {
+
+// The encrypted FNX format: a binary header with the key derivation parameters,
+// the document (maybe compressed with zlib) encrypted with ChaCha20 and an
+// HMAC-SHA256 of all the preceding bytes (encrypt-then-MAC). The keys are derived from the password with
+// PBKDF2-HMAC-SHA256. Unlike SimpleCrypt, the password itself is the secret,
+// a wrong password or a changed file is detected before decrypting, and the
+// result isn't encoded with Base64.
+class FnxCipher
+{
+public:
+    FnxCipher();
+
+    /* whether the device contains an encrypted document of this format */
+    static bool isEncrypted (QIODevice *device);
+
+    /* derives the keys if the password differs from the last one */
+    void setPassword (const QString &password);
+    QString password() const {
+        return password_;
+    }
+
+    /* the zlib level (0 for no compression); data that doesn't seem
+       compressible, like Base64-encoded images, isn't compressed */
+    void setCompressionLevel (int level) {
+        compressionLevel_ = qBound (0, level, 9);
+    }
+
+    /* a fresh nonce is used each time but the salt and keys are reused */
+    QByteArray encrypt (const QByteArray &plain) const;
+    /* on success, the password and keys of the data are kept for encrypting */
+    bool decrypt (const QByteArray &data, const QString &password, QByteArray &plain);
+
+private:
+    void deriveKeys (const QString &password, const QByteArray &salt, quint32 iterations);
+
+    QString password_;
+    QByteArray salt_;
+    quint32 iterations_;
+    int compressionLevel_;
+    QByteArray encKey_;
+    QByteArray macKey_;
+};
+
+}
+
+#endif // FNXCIPHER_H
@@ -0,0 +1,493 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QXmlStreamReader>
+#include <QFile>
+#include <QRegularExpression>
+#include <cstring>
+#include "fnxreader.h"
+
+namespace FeatherNotes {
+
+static QString decodeEntities (const QString &str)
+{
+    int amp = str.indexOf ('&');
+    if (amp < 0) return str;
+
+    QString res;
+    res.reserve (str.size());
+    int last = 0;
+    while (amp > -1)
+    {
+        res.append (str.midRef (last, amp - last));
+        int semi = str.indexOf (';', amp);
+        if (semi < 0)
+        {
+            last = amp;
+            break;
+        }
+        const QString ent = str.mid (amp + 1, semi - amp - 1);
+        if (ent == "lt")
+            res.append ('<');
+        else if (ent == "gt")
+            res.append ('>');
+        else if (ent == "amp")
+            res.append ('&');
+        else if (ent == "quot")
+            res.append ('\"');
+        else if (ent == "apos")
+            res.append ('\'');
+        else
+        {
+            bool ok = false;
+            uint code = 0;
+            if (ent.startsWith ("#x"))
+                code = ent.mid (2).toUInt (&ok, 16);
+            else if (ent.startsWith ("#"))
+                code = ent.mid (1).toUInt (&ok, 10);
+            if (ok && QChar::requiresSurrogates (code))
+            {
+                res.append (QChar (QChar::highSurrogate (code)));
+                res.append (QChar (QChar::lowSurrogate (code)));
+            }
+            else if (ok)
+                res.append (QChar (code));
+            else
+                res.append (str.midRef (amp, semi - amp + 1));
+        }
+        last = semi + 1;
+        amp = str.indexOf ('&', last);
+    }
+    res.append (str.midRef (last));
+    return res;
+}
+/*************************/
+static QString decodeText (const char *data, qint64 length)
+{
+    QString str = QString::fromUtf8 (data, static_cast<int>(length));
+    /* normalize line ends as an XML parser does */
+    if (str.contains ('\r'))
+    {
+        str.replace ("\r\n", "\n");
+        str.replace ('\r', '\n');
+    }
+    return decodeEntities (str);
+}
+/*************************/
+static QString decodeAttribute (const char *data, qint64 length)
+{
+    QString str = QString::fromUtf8 (data, static_cast<int>(length));
+    str.replace ("\r\n", " ");
+    str.replace ('\r', ' ');
+    str.replace ('\n', ' ');
+    str.replace ('\t', ' ');
+    return decodeEntities (str);
+}
+/*************************/
+static inline bool isXmlSpace (char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+/*************************/
+// An FNX file mapped into memory. Texts are decoded only when they are requested.
+class FnxSource : public TextSource
+{
+public:
+    FnxSource (const QString &filePath) : file_ (filePath), data_ (nullptr), size_ (0) {
+        if (file_.open (QIODevice::ReadOnly))
+        {
+            size_ = file_.size();
+            if (size_ > 0)
+                data_ = reinterpret_cast<const char*>(file_.map (0, size_));
+        }
+    }
+    ~FnxSource() {
+        if (data_)
+            file_.unmap (reinterpret_cast<uchar*>(const_cast<char*>(data_)));
+    }
+
+    bool isValid() const {
+        return data_ != nullptr;
+    }
+    const char *data() const {
+        return data_;
+    }
+    qint64 size() const {
+        return size_;
+    }
+
+    QString text (qint64 offset, qint64 length) const {
+        if (offset < 0 || length <= 0 || offset + length > size_)
+            return QString();
+        return decodeText (data_ + offset, length);
+    }
+    QByteArray xmlText (qint64 offset, qint64 length) const {
+        if (offset < 0 || length <= 0 || offset + length > size_)
+            return QByteArray ("");
+        /* no copying; the data is written immediately */
+        return QByteArray::fromRawData (data_ + offset, static_cast<int>(length));
+    }
+
+private:
+    QFile file_;
+    const char *data_;
+    qint64 size_;
+};
+
+FnxReader::FnxReader (QObject *parent) : QObject (parent) {}
+/*************************/
+bool FnxReader::isXml (QIODevice *device)
+{
+    const QByteArray start = device->peek (64);
+    int i = 0;
+    /* skip the UTF-8 BOM */
+    if (start.startsWith ("\xEF\xBB\xBF"))
+        i = 3;
+    while (i < start.size())
+    {
+        char c = start.at (i);
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            return c == '<'; // base64 has no '<'
+        ++i;
+    }
+    return false;
+}
+/*************************/
+// Unlike QDomDocument::setContent(), this doesn't need the whole text in
+// memory and the document tree grows while the device is being read.
+bool FnxReader::read (QIODevice *device, QDomDocument &doc)
+{
+    errorString_.clear();
+    const qint64 total = device->size();
+    int percent = 0;
+    emit progress (percent);
+
+    QXmlStreamReader xml (device);
+    QDomNode current = doc;
+    /* the text may come in more than one piece; it's added when it ends */
+    QString text;
+    auto addText = [&doc, &current, &text] {
+        if (!text.isNull())
+        {
+            current.appendChild (doc.createTextNode (text));
+            text = QString();
+        }
+    };
+    while (!xml.atEnd())
+    {
+        const QXmlStreamReader::TokenType token = xml.readNext();
+        if (token == QXmlStreamReader::StartElement
+            || token == QXmlStreamReader::EndElement
+            || token == QXmlStreamReader::EndDocument)
+        {
+            addText();
+        }
+        switch (token) {
+        case QXmlStreamReader::StartDocument:
+            if (!xml.documentVersion().isEmpty())
+            {
+                QString data = "version=\'" + xml.documentVersion().toString() + "\'";
+                if (!xml.documentEncoding().isEmpty())
+                    data += " encoding=\'" + xml.documentEncoding().toString() + "\'";
+                doc.appendChild (doc.createProcessingInstruction ("xml", data));
+            }
+            break;
+        case QXmlStreamReader::StartElement: {
+            QDomElement e = doc.createElement (xml.name().toString());
+            const QXmlStreamAttributes attributes = xml.attributes();
+            for (const QXmlStreamAttribute &attr : attributes)
+                e.setAttribute (attr.name().toString(), attr.value().toString());
+            current = current.appendChild (e);
+            break;
+        }
+        case QXmlStreamReader::EndElement:
+            current = current.parentNode();
+            /* the progress is reported when a node is read completely */
+            if (total > 0)
+            {
+                int p = static_cast<int>(device->pos() * 100 / total);
+                if (p > percent)
+                {
+                    percent = p;
+                    emit progress (percent);
+                }
+            }
+            break;
+        case QXmlStreamReader::Characters:
+            if (!text.isNull())
+                text += xml.text();
+            /* like QDomDocument::setContent(), ignore whitespaces between elements */
+            else if (!xml.isWhitespace())
+                text = xml.text().toString();
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (xml.hasError())
+    {
+        errorString_ = xml.errorString();
+        doc = QDomDocument();
+        return false;
+    }
+    if (percent < 100)
+        emit progress (100);
+    return true;
+}
+
+/*************************/
+// Here, the file is parsed directly, without QXmlStreamReader, because the byte
+// offsets of texts are needed. Only what FNX files contain is supported; on any
+// problem, false is returned and the file can be read by read() instead.
+bool FnxReader::readMapped (const QString &filePath, QDomDocument &doc,
+                            QSharedPointer<TextSource> &source, QVector<TextRange> &ranges)
+{
+    errorString_.clear();
+    ranges.clear();
+
+    QSharedPointer<FnxSource> fnxSource (new FnxSource (filePath));
+    if (!fnxSource->isValid())
+    {
+        errorString_ = "The file could not be mapped into memory.";
+        return false;
+    }
+    const char *data = fnxSource->data();
+    const qint64 size = fnxSource->size();
+    int percent = 0;
+    emit progress (percent);
+
+    QDomNode current = doc;
+    /* the indexes of open elements in "ranges" (-1 for elements other than nodes) */
+    QVector<int> open;
+    qint64 pos = 0;
+    if (size >= 3 && std::memcmp (data, "\xEF\xBB\xBF", 3) == 0)
+        pos = 3;
+
+    /* the text of an element other than a node may come in more than one piece */
+    QString text;
+    auto addText = [&doc, &current, &text] {
+        if (!text.isNull())
+        {
+            current.appendChild (doc.createTextNode (text));
+            text = QString();
+        }
+    };
+    auto fail = [this, &doc, &ranges] (const QString &error) {
+        errorString_ = error;
+        doc = QDomDocument();
+        ranges.clear();
+        return false;
+    };
+    auto find = [data, size] (qint64 from, const char *str) -> qint64 {
+        const size_t l = std::strlen (str);
+        for (qint64 i = from; i + static_cast<qint64>(l) <= size; ++i)
+        {
+            const char *p = static_cast<const char*>(std::memchr (data + i, str[0], size - i));
+            if (p == nullptr) break;
+            i = p - data;
+            if (i + static_cast<qint64>(l) <= size && std::memcmp (p, str, l) == 0)
+                return i;
+        }
+        return -1;
+    };
+
+    while (pos < size)
+    {
+        if (data[pos] != '<')
+        { // text
+            const char *lt = static_cast<const char*>(std::memchr (data + pos, '<', size - pos));
+            const qint64 end = lt ? lt - data : size;
+            bool whitespace = true;
+            for (qint64 i = pos; i < end; ++i)
+            {
+                if (!isXmlSpace (data[i]))
+                {
+                    whitespace = false;
+                    break;
+                }
+            }
+            if (!whitespace)
+            {
+                if (open.isEmpty())
+                    return fail ("Text outside the root element.");
+                const int indx = open.last();
+                if (indx >= 0 && current.firstChild().isNull() && ranges.at (indx).offset < 0)
+                { // the text of a node
+                    ranges[indx].offset = pos;
+                    ranges[indx].length = end - pos;
+                }
+                else
+                    text += decodeText (data + pos, end - pos);
+            }
+            pos = end;
+            continue;
+        }
+
+        if (pos + 1 >= size)
+            return fail ("Unexpected end of file.");
+        const char next = data[pos + 1];
+        if (next == '?')
+        { // processing instruction
+            qint64 end = find (pos + 2, "?>");
+            if (end < 0) return fail ("Unexpected end of file.");
+            if (current == doc)
+            {
+                qint64 i = pos + 2;
+                while (i < end && !isXmlSpace (data[i])) ++i;
+                const QString target = QString::fromUtf8 (data + pos + 2, static_cast<int>(i - pos - 2));
+                const QString pi = QString::fromUtf8 (data + i, static_cast<int>(end - i)).trimmed();
+                if (target == "xml")
+                { // files of old versions may be in the encoding of the locale
+                    static const QRegularExpression encoding (R"(encoding\s*=\s*["']([^"']*)["'])");
+                    const QString enc = encoding.match (pi).captured (1);
+                    if (!enc.isEmpty()
+                        && enc.compare ("UTF-8", Qt::CaseInsensitive) != 0
+                        && enc.compare ("UTF8", Qt::CaseInsensitive) != 0)
+                    {
+                        return fail ("Unsupported encoding.");
+                    }
+                }
+                doc.appendChild (doc.createProcessingInstruction (target, pi));
+            }
+            pos = end + 2;
+        }
+        else if (next == '!')
+        {
+            if (pos + 3 < size && data[pos + 2] == '-' && data[pos + 3] == '-')
+            { // comment (not inside nodes, where it could split texts)
+                if (!open.isEmpty()) return fail ("Comments inside elements are not supported.");
+                qint64 end = find (pos + 4, "-->");
+                if (end < 0) return fail ("Unexpected end of file.");
+                pos = end + 3;
+            }
+            else if (pos + 8 < size && std::memcmp (data + pos + 2, "[CDATA[", 7) == 0)
+                return fail ("CDATA sections are not supported.");
+            else
+            { // DOCTYPE (maybe with an internal subset)
+                int depth = 0;
+                qint64 i = pos + 2;
+                for (; i < size; ++i)
+                {
+                    if (data[i] == '[') ++depth;
+                    else if (data[i] == ']') --depth;
+                    else if (data[i] == '>' && depth <= 0) break;
+                }
+                if (i >= size) return fail ("Unexpected end of file.");
+                pos = i + 1;
+            }
+        }
+        else if (next == '/')
+        { // end tag
+            const char *gt = static_cast<const char*>(std::memchr (data + pos, '>', size - pos));
+            if (gt == nullptr) return fail ("Unexpected end of file.");
+            if (open.isEmpty()) return fail ("Unexpected end tag.");
+            qint64 nameEnd = gt - data;
+            while (nameEnd > pos + 2 && isXmlSpace (data[nameEnd - 1])) --nameEnd;
+            if (QString::fromUtf8 (data + pos + 2, static_cast<int>(nameEnd - pos - 2)) != current.nodeName())
+                return fail ("Mismatched end tag.");
+            addText();
+            open.removeLast();
+            current = current.parentNode();
+            pos = gt - data + 1;
+
+            int p = static_cast<int>(pos * 100 / size);
+            if (p > percent)
+            {
+                percent = p;
+                emit progress (percent);
+            }
+        }
+        else
+        { // start tag
+            qint64 i = pos + 1;
+            while (i < size && !isXmlSpace (data[i]) && data[i] != '/' && data[i] != '>') ++i;
+            if (i >= size) return fail ("Unexpected end of file.");
+            const QString name = QString::fromUtf8 (data + pos + 1, static_cast<int>(i - pos - 1));
+            if (name.isEmpty()) return fail ("Invalid start tag.");
+            QDomElement e = doc.createElement (name);
+            addText();
+
+            bool empty = false;
+            for (;;)
+            {
+                while (i < size && isXmlSpace (data[i])) ++i;
+                if (i >= size) return fail ("Unexpected end of file.");
+                if (data[i] == '>')
+                {
+                    ++i;
+                    break;
+                }
+                if (data[i] == '/')
+                {
+                    if (i + 1 >= size || data[i + 1] != '>')
+                        return fail ("Invalid start tag.");
+                    empty = true;
+                    i += 2;
+                    break;
+                }
+                /* an attribute */
+                qint64 start = i;
+                while (i < size && data[i] != '=' && !isXmlSpace (data[i]) && data[i] != '>') ++i;
+                const QString attrName = QString::fromUtf8 (data + start, static_cast<int>(i - start));
+                while (i < size && isXmlSpace (data[i])) ++i;
+                if (i + 1 >= size || data[i] != '=' || attrName.isEmpty())
+                    return fail ("Invalid attribute.");
+                ++i;
+                while (i < size && isXmlSpace (data[i])) ++i;
+                if (i >= size || (data[i] != '\"' && data[i] != '\''))
+                    return fail ("Invalid attribute.");
+                const char quote = data[i];
+                start = ++i;
+                const char *q = static_cast<const char*>(std::memchr (data + i, quote, size - i));
+                if (q == nullptr) return fail ("Unexpected end of file.");
+                i = q - data;
+                e.setAttribute (attrName, decodeAttribute (data + start, i - start));
+                ++i;
+            }
+
+            /* nodes that have items in the model (see DomItem) */
+            int indx = -1;
+            if (name == "node" && !open.isEmpty()
+                && (open.last() >= 0 || (open.count() == 1 && current.nodeName() == "feathernotes")))
+            {
+                indx = ranges.count();
+                ranges.append (TextRange {-1, 0});
+            }
+            else if (open.isEmpty() && current != doc)
+                return fail ("Invalid document.");
+
+            current.appendChild (e);
+            if (!empty)
+            {
+                current = e;
+                open.append (indx);
+            }
+            pos = i;
+        }
+    }
+
+    if (!open.isEmpty())
+        return fail ("Unexpected end of file.");
+    if (percent < 100)
+        emit progress (100);
+
+    source = fnxSource;
+    return true;
+}
+
+}
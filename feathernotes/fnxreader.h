@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FNXREADER_H
+#define FNXREADER_H
+
+#include <QObject>
+#include <QIODevice>
+#include <QDomDocument>
+#include <QSharedPointer>
+#include <QVector>
+#include "textsource.h"
+
+namespace FeatherNotes {
+
+// Builds the DOM tree of an FNX document incrementally while reading it.
+class FnxReader : public QObject
+{
+    Q_OBJECT
+public:
+    FnxReader (QObject *parent = nullptr);
+
+    /* the device should be opened for reading */
+    bool read (QIODevice *device, QDomDocument &doc);
+    /* maps the file into memory and puts node texts in the source instead of
+       the DOM tree (the ranges are in the order of nodes in the file) */
+    bool readMapped (const QString &filePath, QDomDocument &doc,
+                     QSharedPointer<TextSource> &source, QVector<TextRange> &ranges);
+
+    QString errorString() const {
+        return errorString_;
+    }
+
+    /* whether the device contains plain XML (and not an encrypted document) */
+    static bool isXml (QIODevice *device);
+
+signals:
+    void progress (int percent);
+
+private:
+    QString errorString_;
+};
+
+}
+
+#endif // FNXREADER_H
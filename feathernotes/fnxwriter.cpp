@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QTextStream>
+#include <QDomElement>
+#include <QDomNamedNodeMap>
+#include <QSet>
+#include <QStringList>
+#include "fnxwriter.h"
+#include "dommodel.h"
+#include "domitem.h"
+
+namespace FeatherNotes {
+
+static QString escapeText (const QString &str, bool attribute)
+{
+    QString res;
+    res.reserve (str.size() + str.size() / 16);
+    for (const QChar &c : str)
+    {
+        switch (c.unicode()) {
+        case '<':
+            res.append ("&lt;");
+            break;
+        case '>':
+            res.append ("&gt;");
+            break;
+        case '&':
+            res.append ("&amp;");
+            break;
+        case '\r':
+            res.append ("&#xd;");
+            break;
+        case '"':
+            if (attribute) res.append ("&quot;");
+            else res.append (c);
+            break;
+        case '\n':
+            if (attribute) res.append ("&#xa;");
+            else res.append (c);
+            break;
+        case '\t':
+            if (attribute) res.append ("&#x9;");
+            else res.append (c);
+            break;
+        default:
+            res.append (c);
+            break;
+        }
+    }
+    return res;
+}
+/*************************/
+static QVector<QPair<QString, QString> > nodeAttributes (const QDomNode &node)
+{
+    QVector<QPair<QString, QString> > res;
+    const QDomNamedNodeMap attributes = node.attributes();
+    res.reserve (attributes.count());
+    for (int i = 0; i < attributes.count(); ++i)
+    {
+        const QDomNode attr = attributes.item (i);
+        res << qMakePair (attr.nodeName(), attr.nodeValue());
+    }
+    return res;
+}
+/*************************/
+static void writeAttributes (QTextStream &out, const QVector<QPair<QString, QString> > &attributes)
+{
+    for (const auto &attr : attributes)
+        out << ' ' << attr.first << "=\"" << escapeText (attr.second, true) << '"';
+}
+/*************************/
+static void addItem (FnxSnapshot &snapshot, DomItem *item)
+{
+    FnxSnapshot::Node node;
+    node.attributes = nodeAttributes (item->node());
+    node.source = item->lazyTextSource();
+    if (node.source)
+        node.range = item->lazyTextRange();
+    else
+    {
+        node.text = item->text();
+        node.range.offset = -1;
+        node.range.length = 0;
+    }
+    node.childCount = item->childCount();
+    snapshot.nodes << node;
+    for (int i = 0; i < node.childCount; ++i)
+        addItem (snapshot, item->child (i));
+}
+/*************************/
+FnxSnapshot FnxWriter::snapshot (DomModel *model)
+{
+    FnxSnapshot snapshot;
+    snapshot.rootAttributes = nodeAttributes (model->domDocument.firstChildElement ("feathernotes"));
+    snapshot.images = model->imageStore.encodedImages();
+    DomItem *rootItem = model->rootItem();
+    for (int i = 0; i < rootItem->childCount(); ++i)
+        addItem (snapshot, rootItem->child (i));
+    return snapshot;
+}
+/*************************/
+// Finds the images of the store that are referenced in a node text.
+template <class T>
+static void findImages (const T &text, const char *ref, QSet<QString> &ids)
+{
+    static const int refLength = 6; // "fnimg:"
+    int i = 0;
+    while ((i = text.indexOf (ref, i)) != -1)
+    {
+        i += refLength;
+        int j = i;
+        while (j < text.size()
+               && ((text.at (j) >= '0' && text.at (j) <= '9') || (text.at (j) >= 'a' && text.at (j) <= 'f')))
+        {
+            ++j;
+        }
+        if (j > i)
+            ids.insert (QString (text.mid (i, j - i)));
+        i = j;
+    }
+}
+/*************************/
+// The text comes immediately after the start tag and is followed by the first child
+// without whitespaces because whitespaces would be added to the text when reading.
+static bool writeNode (QTextStream &out, QIODevice *device,
+                       const QVector<FnxSnapshot::Node> &nodes, int &index,
+                       int depth, bool indent, QSet<QString> &images)
+{
+    const FnxSnapshot::Node &node = nodes.at (index);
+    ++index;
+    if (indent)
+        out << QString (depth, ' ');
+    out << "<node";
+    writeAttributes (out, node.attributes);
+
+    bool hasText = false;
+    QByteArray raw;
+    QString txt = node.text;
+    if (node.source)
+    {
+        raw = node.source->xmlText (node.range.offset, node.range.length);
+        if (raw.isNull())
+            txt = node.source->text (node.range.offset, node.range.length);
+    }
+    if (!raw.isNull())
+    { // write the encoded text as it is
+        if (!raw.isEmpty())
+        {
+            findImages (raw, "fnimg:", images);
+            out << '>';
+            out.flush();
+            if (device->write (raw) != raw.size())
+                return false;
+            hasText = true;
+        }
+    }
+    else if (!txt.isEmpty())
+    {
+        findImages (txt, "fnimg:", images);
+        out << '>' << escapeText (txt, false);
+        hasText = true;
+    }
+
+    const int count = node.childCount;
+    if (!hasText && count == 0)
+    {
+        out << "/>\n";
+        return out.status() == QTextStream::Ok;
+    }
+    if (!hasText)
+        out << ">\n";
+    for (int i = 0; i < count; ++i)
+    {
+        if (!writeNode (out, device, nodes, index, depth + 1, !hasText || i > 0, images))
+            return false;
+    }
+    if (count > 0)
+        out << QString (depth, ' ');
+    out << "</node>\n";
+    return out.status() == QTextStream::Ok;
+}
+/*************************/
+bool FnxWriter::write (DomModel *model, QIODevice *device)
+{
+    return write (snapshot (model), device);
+}
+/*************************/
+bool FnxWriter::write (const FnxSnapshot &snapshot, QIODevice *device)
+{
+    QTextStream out (device);
+    out.setCodec ("UTF-8");
+    out << "<?xml version='1.0' encoding='utf-8'?>\n";
+
+    out << "<feathernotes";
+    writeAttributes (out, snapshot.rootAttributes);
+
+    if (snapshot.nodes.isEmpty())
+        out << "/>\n";
+    else
+    {
+        out << ">\n";
+        QSet<QString> images;
+        int index = 0;
+        while (index < snapshot.nodes.size())
+        {
+            if (!writeNode (out, device, snapshot.nodes, index, 1, true, images))
+                return false;
+        }
+
+        /* only the referenced images are written, in a fixed order */
+        QStringList ids;
+        for (const QString &id : images)
+        {
+            if (snapshot.images.contains (id))
+                ids << id;
+        }
+        if (!ids.isEmpty())
+        {
+            ids.sort();
+            out << " <images>\n";
+            for (const QString &id : ids)
+            {
+                out << "  <image id=\"" << id << "\">";
+                out.flush();
+                const QByteArray base64 = snapshot.images.value (id);
+                if (device->write (base64) != base64.size())
+                    return false;
+                out << "</image>\n";
+            }
+            out << " </images>\n";
+        }
+
+        out << "</feathernotes>\n";
+    }
+
+    out.flush();
+    return out.status() == QTextStream::Ok;
+}
+
+}
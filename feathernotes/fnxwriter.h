@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FNXWRITER_H
+#define FNXWRITER_H
+
+#include <QIODevice>
+#include <QVector>
+#include <QPair>
+#include <QSharedPointer>
+#include <QHash>
+#include "textsource.h"
+
+namespace FeatherNotes {
+
+class DomModel;
+
+// A copy of a document that doesn't depend on its DOM tree and can therefore be
+// written in another thread. Strings are shared implicitly and lazily loaded texts
+// aren't read, so that taking a snapshot is cheap even with huge documents.
+struct FnxSnapshot
+{
+    struct Node
+    {
+        QVector<QPair<QString, QString> > attributes;
+        QString text;
+        QSharedPointer<TextSource> source; // if set, the text is read from it
+        TextRange range;
+        int childCount;
+    };
+
+    QVector<QPair<QString, QString> > rootAttributes;
+    QVector<Node> nodes; // in pre-order
+    QHash<QString, QByteArray> images; // the Base64-encoded images of the store
+};
+
+// Writes the DOM tree of a model as an FNX document. Unlike QDomDocument::save(),
+// it also writes the node texts that are read from text sources.
+class FnxWriter
+{
+public:
+    static FnxSnapshot snapshot (DomModel *model);
+
+    /* the device should be opened for writing */
+    static bool write (DomModel *model, QIODevice *device);
+    static bool write (const FnxSnapshot &snapshot, QIODevice *device);
+};
+
+}
+
+#endif // FNXWRITER_H
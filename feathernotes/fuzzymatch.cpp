@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fuzzymatch.h"
+#include <QHash>
+
+namespace FeatherNotes {
+
+/* the Levenshtein distance of two short strings */
+static int editDistance (const QStringRef &a, const QString &b)
+{
+    QVector<int> row (b.length() + 1);
+    for (int j = 0; j <= b.length(); ++j)
+        row[j] = j;
+    for (int i = 1; i <= a.length(); ++i)
+    {
+        int diag = row.at (0);
+        row[0] = i;
+        for (int j = 1; j <= b.length(); ++j)
+        {
+            const int up = row.at (j);
+            row[j] = qMin (qMin (up, row.at (j - 1)) + 1,
+                           diag + (a.at (i - 1) == b.at (j - 1) ? 0 : 1));
+            diag = up;
+        }
+    }
+    return row.at (b.length());
+}
+/*************************/
+// Myers's bit-parallel approximate matching: the text is scanned once and the
+// edit distance of the pattern to the best substring ending at each position
+// is updated with a few bit operations. A match may begin anywhere, so the
+// first row of the distance matrix is zero (no bit is shifted into "ph").
+QVector<FuzzyMatch> fuzzyFind (const QString &text, const QString &pattern,
+                               Qt::CaseSensitivity cs, int maxMatches)
+{
+    QVector<FuzzyMatch> res;
+    const QString pat = cs == Qt::CaseSensitive ? pattern : pattern.toCaseFolded();
+    const QString hay = cs == Qt::CaseSensitive ? text : text.toCaseFolded();
+    const int m = pat.length();
+    if (m == 0 || m > 64 || hay.length() != text.length()) return res;
+    const int k = maxTypos (m);
+
+    quint64 latin[256] = {};
+    QHash<ushort, quint64> others;
+    for (int i = 0; i < m; ++i)
+    {
+        const ushort c = pat.at (i).unicode();
+        if (c < 256)
+            latin[c] |= quint64 (1) << i;
+        else
+            others[c] |= quint64 (1) << i;
+    }
+    const quint64 last = quint64 (1) << (m - 1);
+
+    quint64 pv = ~quint64 (0), mv = 0;
+    int score = m;
+    int bestEnd = -1, bestScore = k + 1;
+    for (int j = 0; j <= hay.length(); ++j)
+    {
+        if (j < hay.length())
+        {
+            const ushort c = hay.at (j).unicode();
+            const quint64 eq = c < 256 ? latin[c] : others.value (c);
+            const quint64 xv = eq | mv;
+            const quint64 xh = (((eq & pv) + pv) ^ pv) | eq;
+            quint64 ph = mv | ~(xh | pv);
+            quint64 mh = pv & xh;
+            if (ph & last) ++score;
+            else if (mh & last) --score;
+            ph <<= 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+        }
+        /* of adjacent ends within the threshold, the best one is taken */
+        if (j < hay.length() && score <= k)
+        {
+            if (score < bestScore)
+            {
+                bestScore = score;
+                bestEnd = j;
+            }
+        }
+        else if (bestEnd >= 0)
+        {
+            /* find the start that gives the least distance */
+            int bestStart = bestEnd;
+            int dist = k + 1;
+            const int from = qMax (0, bestEnd - m - k + 1);
+            const int to = qMax (from, bestEnd - m + k + 1);
+            for (int s = from; s <= to && s <= bestEnd; ++s)
+            {
+                const int d = editDistance (hay.midRef (s, bestEnd - s + 1), pat);
+                if (d < dist)
+                {
+                    dist = d;
+                    bestStart = s;
+                }
+            }
+            /* a match shouldn't begin or end with whitespace */
+            int end = bestEnd + 1;
+            while (bestStart < end - 1 && text.at (bestStart).isSpace()) ++bestStart;
+            while (end - 1 > bestStart && text.at (end - 1).isSpace()) --end;
+            FuzzyMatch match;
+            match.position = bestStart;
+            match.length = end - bestStart;
+            match.typos = bestScore;
+            res.append (match);
+            if (res.count() >= maxMatches) break;
+            bestEnd = -1;
+            bestScore = k + 1;
+        }
+    }
+    return res;
+}
+
+}
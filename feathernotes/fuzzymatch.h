@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FUZZYMATCH_H
+#define FUZZYMATCH_H
+
+#include <QString>
+#include <QVector>
+
+namespace FeatherNotes {
+
+struct FuzzyMatch
+{
+    int position;
+    int length;
+    int typos;
+};
+
+/* the number of errors tolerated by the fuzzy search */
+inline int maxTypos (int patternLength)
+{
+    return patternLength < 4 ? 0 : patternLength / 4;
+}
+
+/* Finds the substrings of a text that are within "maxTypos()" edits of a
+   pattern of up to 64 characters, in a single pass over the text. */
+QVector<FuzzyMatch> fuzzyFind (const QString &text, const QString &pattern,
+                               Qt::CaseSensitivity cs, int maxMatches);
+
+}
+
+#endif // FUZZYMATCH_H
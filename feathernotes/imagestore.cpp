@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCryptographicHash>
+#include <QRegularExpression>
+#include <QTextDocument>
+#include "imagestore.h"
+
+namespace FeatherNotes {
+
+static const QRegularExpression IMAGE_REF ("fnimg:([0-9a-f]+)");
+
+ImageStore::ImageStore() : unsaved_ (false) {}
+/*************************/
+QString ImageStore::idOf (const QUrl &url)
+{
+    if (url.scheme() == scheme())
+        return url.path();
+    return QString();
+}
+/*************************/
+QString ImageStore::add (const QByteArray &data)
+{
+    const QString id = QString::fromLatin1 (QCryptographicHash::hash (data, QCryptographicHash::Sha1).toHex());
+    if (!images_.contains (id))
+    {
+        images_.insert (id, data.toBase64());
+        unsaved_ = true;
+    }
+    return id;
+}
+/*************************/
+void ImageStore::insertEncoded (const QString &id, const QByteArray &base64)
+{
+    if (!id.isEmpty())
+        images_.insert (id, base64);
+}
+/*************************/
+QByteArray ImageStore::data (const QString &id) const
+{
+    return QByteArray::fromBase64 (images_.value (id));
+}
+/*************************/
+QImage ImageStore::image (const QString &id) const
+{
+    QHash<QString, QImage>::const_iterator it = cache_.constFind (id);
+    if (it != cache_.constEnd())
+        return it.value();
+    QImage img;
+    if (images_.contains (id))
+    {
+        img.loadFromData (data (id));
+        cache_.insert (id, img);
+    }
+    return img;
+}
+/*************************/
+void ImageStore::addResources (QTextDocument *doc, const QString &html) const
+{
+    QRegularExpressionMatchIterator it = IMAGE_REF.globalMatch (html);
+    while (it.hasNext())
+    {
+        const QString id = it.next().captured (1);
+        if (images_.contains (id))
+            doc->addResource (QTextDocument::ImageResource, QUrl (url (id)), image (id));
+    }
+}
+/*************************/
+QString ImageStore::embedImages (const QString &html) const
+{
+    if (images_.isEmpty()) return html;
+    QString res;
+    int last = 0;
+    QRegularExpressionMatchIterator it = IMAGE_REF.globalMatch (html);
+    while (it.hasNext())
+    {
+        const QRegularExpressionMatch match = it.next();
+        const QString id = match.captured (1);
+        if (!images_.contains (id)) continue;
+        res.append (html.midRef (last, match.capturedStart() - last));
+        res.append ("data:image;base64,");
+        res.append (QString::fromLatin1 (images_.value (id)));
+        last = match.capturedEnd();
+    }
+    if (last == 0) return html;
+    res.append (html.midRef (last));
+    return res;
+}
+
+}
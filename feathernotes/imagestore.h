@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGESTORE_H
+#define IMAGESTORE_H
+
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+#include <QImage>
+#include <QUrl>
+
+class QTextDocument;
+
+namespace FeatherNotes {
+
+// The images of a document, keyed by the hashes of their contents, so that each
+// image is stored once in the FNX file and node texts only contain references
+// like <img src="fnimg:HASH">. Images are kept encoded and aren't re-encoded
+// on saving.
+class ImageStore
+{
+public:
+    ImageStore();
+
+    static QString scheme() {
+        return QStringLiteral ("fnimg");
+    }
+    static QString url (const QString &id) {
+        return scheme() + ":" + id;
+    }
+    /* the id of a URL with the scheme of the store (otherwise, an empty string) */
+    static QString idOf (const QUrl &url);
+
+    /* returns the id of the image data */
+    QString add (const QByteArray &data);
+    void insertEncoded (const QString &id, const QByteArray &base64);
+
+    bool isEmpty() const {
+        return images_.isEmpty();
+    }
+    bool contains (const QString &id) const {
+        return images_.contains (id);
+    }
+    QByteArray data (const QString &id) const;
+    QImage image (const QString &id) const;
+    /* the Base64-encoded images (shared implicitly) */
+    QHash<QString, QByteArray> encodedImages() const {
+        return images_;
+    }
+
+    /* whether images are added after the last saving */
+    bool hasUnsavedImages() const {
+        return unsaved_;
+    }
+    void setSaved() {
+        unsaved_ = false;
+    }
+
+    /* makes the referenced images available to a document that isn't shown */
+    void addResources (QTextDocument *doc, const QString &html) const;
+    /* replaces references with embedded images */
+    QString embedImages (const QString &html) const;
+
+private:
+    QHash<QString, QByteArray> images_;
+    mutable QHash<QString, QImage> cache_;
+    bool unsaved_;
+};
+
+}
+
+#endif // IMAGESTORE_H
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include "journal.h"
+#include "domitem.h"
+#include "atomicfile.h"
+
+namespace FeatherNotes {
+
+static const quint32 JOURNAL_MAGIC = 0x464e4a31; // "FNJ1"
+static const qint64 FINGERPRINT_CHUNK = 1048576;
+/*************************/
+QString Journal::journalPath (const QString &filePath)
+{
+    return filePath + ".journal";
+}
+/*************************/
+bool Journal::exists (const QString &filePath)
+{
+    return QFile::exists (journalPath (filePath));
+}
+/*************************/
+// The hash of the whole file, so that any change in it (even one that keeps
+// its size) is noticed. Unlike the modification time, it doesn't change when
+// the file is copied.
+QByteArray Journal::fingerprint (const QString &filePath)
+{
+    QFile file (filePath);
+    if (!file.open (QIODevice::ReadOnly))
+        return QByteArray();
+    QCryptographicHash hash (QCryptographicHash::Sha1);
+    hash.addData (QByteArray::number (file.size()));
+    while (!file.atEnd())
+    {
+        const QByteArray chunk = file.read (FINGERPRINT_CHUNK);
+        if (chunk.isEmpty())
+            return QByteArray(); // a read error
+        hash.addData (chunk);
+    }
+    return hash.result();
+}
+/*************************/
+bool Journal::append (const QString &filePath, const QList<JournalRecord> &records, bool sync)
+{
+    QFile file (journalPath (filePath));
+    if (!file.open (QIODevice::WriteOnly | QIODevice::Append))
+        return false;
+
+    QDataStream out (&file);
+    out.setVersion (QDataStream::Qt_5_0);
+    if (file.size() == 0)
+    {
+        const QByteArray print = fingerprint (filePath);
+        if (print.isEmpty())
+            return false;
+        out << JOURNAL_MAGIC << print;
+    }
+
+    for (const JournalRecord &record : records)
+    {
+        QByteArray data;
+        {
+            QDataStream s (&data, QIODevice::WriteOnly);
+            s.setVersion (QDataStream::Qt_5_0);
+            s << record.path << record.text;
+        }
+        /* the checksum reveals a record that isn't written completely */
+        out << data << qChecksum (data.constData(), static_cast<uint>(data.size()));
+    }
+
+    if (out.status() != QDataStream::Ok || !file.flush())
+        return false;
+    file.close();
+    if (sync)
+        AtomicFile::sync (file.fileName());
+    return true;
+}
+/*************************/
+bool Journal::read (const QString &filePath, QList<JournalRecord> &records)
+{
+    records.clear();
+    QFile file (journalPath (filePath));
+    if (!file.open (QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in (&file);
+    in.setVersion (QDataStream::Qt_5_0);
+    quint32 magic;
+    QByteArray print;
+    in >> magic >> print;
+    if (in.status() != QDataStream::Ok || magic != JOURNAL_MAGIC
+        || print.isEmpty() || print != fingerprint (filePath))
+    {
+        return false;
+    }
+
+    qint64 validEnd = file.pos();
+    while (!in.atEnd())
+    {
+        QByteArray data;
+        quint16 checksum;
+        in >> data >> checksum;
+        if (in.status() != QDataStream::Ok
+            || checksum != qChecksum (data.constData(), static_cast<uint>(data.size())))
+        {
+            break;
+        }
+        JournalRecord record;
+        QDataStream s (data);
+        s.setVersion (QDataStream::Qt_5_0);
+        s >> record.path >> record.text;
+        if (s.status() != QDataStream::Ok)
+            break;
+        records << record;
+        validEnd = file.pos();
+    }
+
+    /* a record that isn't written completely (because of a crash) is
+       removed; otherwise, the records appended after it would be lost */
+    if (validEnd < file.size())
+    {
+        file.close();
+        if (!QFile::resize (journalPath (filePath), validEnd))
+            return false;
+    }
+    return true;
+}
+/*************************/
+bool Journal::remove (const QString &filePath)
+{
+    QString path = journalPath (filePath);
+    return !QFile::exists (path) || QFile::remove (path);
+}
+/*************************/
+QVector<int> Journal::itemPath (DomItem *item)
+{
+    QVector<int> path;
+    while (item && item->parent())
+    {
+        path.prepend (item->row());
+        item = item->parent();
+    }
+    return path;
+}
+/*************************/
+DomItem *Journal::itemAt (DomItem *rootItem, const QVector<int> &path)
+{
+    DomItem *item = rootItem;
+    for (int row : path)
+    {
+        if (!item) break;
+        item = item->child (row);
+    }
+    return item == rootItem ? nullptr : item;
+}
+/*************************/
+void Journal::apply (DomItem *rootItem, const QList<JournalRecord> &records)
+{
+    for (const JournalRecord &record : records)
+    {
+        if (DomItem *item = itemAt (rootItem, record.path))
+            item->setText (record.text);
+    }
+}
+
+}
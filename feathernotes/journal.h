@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <QString>
+#include <QVector>
+#include <QList>
+
+namespace FeatherNotes {
+
+class DomItem;
+
+/* a changed node text and the place of its node in the tree */
+struct JournalRecord
+{
+    QVector<int> path; // rows from the top level down to the node
+    QString text;
+};
+
+// An append-only journal of changed node texts, kept beside an FNX file until the
+// file is rewritten. It's valid only for the exact file it was started with and
+// only as long as the tree structure isn't changed, so that node paths stay valid.
+class Journal
+{
+public:
+    static QString journalPath (const QString &filePath);
+    static bool exists (const QString &filePath);
+    static bool append (const QString &filePath, const QList<JournalRecord> &records, bool sync);
+    /* reads the records if the journal belongs to the file
+       (a broken end is cut off, so that records can be appended) */
+    static bool read (const QString &filePath, QList<JournalRecord> &records);
+    static bool remove (const QString &filePath);
+
+    static QVector<int> itemPath (DomItem *item);
+    static DomItem *itemAt (DomItem *rootItem, const QVector<int> &path);
+    /* applies the records to the items under the root item */
+    static void apply (DomItem *rootItem, const QList<JournalRecord> &records);
+
+    /* identifies the contents of a file (also used by the search index cache) */
+    static QByteArray fingerprint (const QString &filePath);
+};
+
+}
+
+#endif // JOURNAL_H
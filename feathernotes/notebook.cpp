@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "notebook.h"
+#include "domitem.h"
+
+namespace FeatherNotes {
+
+void Notebook::setItems (DomItem *rootItem)
+{
+    rows_.clear();
+    items_.clear();
+    int i = 0;
+    QList<DomItem*> stack;
+    for (int r = rootItem->childCount() - 1; r >= 0; --r)
+        stack << rootItem->child (r);
+    while (!stack.isEmpty() && i < order_.count())
+    {
+        DomItem *item = stack.takeLast();
+        const qint64 id = order_.at (i++);
+        if (id > 0) // otherwise, the node will be saved as a new one
+        {
+            Row row;
+            row.id = id;
+            row.generation = item->textGeneration();
+            rows_.insert (item, row);
+            items_.insert (id, item);
+        }
+        for (int r = item->childCount() - 1; r >= 0; --r)
+            stack << item->child (r);
+    }
+    order_.clear();
+}
+/*************************/
+void Notebook::keepRows (const QSet<qint64> &kept)
+{
+    QHash<DomItem*, Row>::iterator it = rows_.begin();
+    while (it != rows_.end())
+    {
+        if (kept.contains (it.value().id))
+            ++it;
+        else
+        {
+            items_.remove (it.value().id);
+            it = rows_.erase (it);
+        }
+    }
+}
+/*************************/
+void Notebook::setRows (const QHash<DomItem*, Row> &rows)
+{
+    rows_ = rows;
+    items_.clear();
+    QHash<DomItem*, Row>::const_iterator it;
+    for (it = rows_.constBegin(); it != rows_.constEnd(); ++it)
+        items_.insert (it.value().id, it.key());
+}
+
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOTEBOOK_H
+#define NOTEBOOK_H
+
+#include <QDomDocument>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QVector>
+#include "textsource.h"
+
+namespace FeatherNotes {
+
+class DomItem;
+class DomModel;
+
+// A document that is kept node by node (as in a database or a directory), so
+// that node texts are read only when they are needed and saving writes only
+// what has changed. Each node has an id, which is also the offset of its text.
+class Notebook : public TextSource
+{
+public:
+    Notebook (const QString &filePath) : filePath_ (filePath) {}
+    virtual ~Notebook() {}
+
+    QString filePath() const {
+        return filePath_;
+    }
+    QString errorString() const {
+        return errorString_;
+    }
+
+    /* reads everything except for node texts (the ranges are in pre-order) */
+    virtual bool read (QDomDocument &doc, QVector<TextRange> &ranges) = 0;
+    /* pairs the items of the model made from the read document with their ids */
+    void setItems (DomItem *rootItem);
+
+    /* updates the texts of nodes that are already saved (if a node
+       is new, false is returned and the whole document should be saved) */
+    virtual bool saveTexts (const QList<DomItem*> &items) = 0;
+    /* writes the whole document, including its structure and images */
+    virtual bool saveAll (DomModel *model) = 0;
+
+protected:
+    struct Row
+    {
+        qint64 id;
+        quint32 generation; // The generation of the saved node text.
+    };
+
+    /* forgets the nodes that aren't kept */
+    void keepRows (const QSet<qint64> &kept);
+    /* restores the rows, e.g., after a failed saving */
+    void setRows (const QHash<DomItem*, Row> &rows);
+
+    QString filePath_;
+    QString errorString_;
+    QVector<qint64> order_; // The ids of the read nodes in pre-order.
+    QHash<DomItem*, Row> rows_;
+    QHash<qint64, DomItem*> items_;
+};
+
+}
+
+#endif // NOTEBOOK_H
@@ -303,12 +303,93 @@ PrefDialog::PrefDialog (QWidget *parent)
             }
         });
 
+        /* limiting the number of node editors */
+        ui->editorLimitSpinBox->setRange (5, 1000);
+        if (win->getEditorLimit() > -1)
+        {
+            ui->editorLimitSpinBox->setValue (win->getEditorLimit());
+            ui->editorLimitBox->setChecked (true);
+        }
+        else
+        {
+            ui->editorLimitSpinBox->setEnabled (false);
+            ui->editorLimitSpinBox->setValue (100);
+        }
+        connect (ui->editorLimitSpinBox, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), win, [win] (int value) {
+            win->setEditorLimit (value);
+        });
+        connect (ui->editorLimitBox, &QCheckBox::stateChanged, win, [this, win] (int checked) {
+            if (checked == Qt::Checked)
+            {
+                ui->editorLimitSpinBox->setEnabled (true);
+                win->setEditorLimit (ui->editorLimitSpinBox->value());
+            }
+            else if (checked == Qt::Unchecked)
+            {
+                ui->editorLimitSpinBox->setEnabled (false);
+                win->setEditorLimit (-1);
+            }
+        });
+
         /* scroll jump workaround */
         ui->workaroundBox->setChecked (win->isScrollJumpWorkaroundEnabled());
         connect (ui->workaroundBox, &QCheckBox::stateChanged, win, [win] (int checked) {
             win->enableScrollJumpWorkaround (checked == Qt::Checked);
         });
 
+        /*************
+         *** Files ***
+         *************/
+
+        /* lazy loading of node texts */
+        ui->lazyBox->setChecked (win->hasLazyLoading());
+        connect (ui->lazyBox, &QCheckBox::stateChanged, win, [win] (int checked) {
+            win->setLazyLoading (checked == Qt::Checked);
+        });
+
+        /* incremental saving */
+        ui->journalBox->setChecked (win->hasJournal());
+        connect (ui->journalBox, &QCheckBox::stateChanged, win, [win] (int checked) {
+            win->setJournal (checked == Qt::Checked);
+        });
+
+        /* storing images once per document */
+        ui->imageStoreBox->setChecked (win->hasImageStore());
+        connect (ui->imageStoreBox, &QCheckBox::stateChanged, win, [win] (int checked) {
+            win->setImageStore (checked == Qt::Checked);
+        });
+
+        /* shrinking scaled-down images */
+        ui->shrinkBox->setChecked (win->hasImageShrinking());
+        connect (ui->shrinkBox, &QCheckBox::stateChanged, win, [win] (int checked) {
+            win->setImageShrinking (checked == Qt::Checked);
+        });
+
+        /* caching the search index */
+        ui->indexBox->setChecked (win->hasIndexCache());
+        connect (ui->indexBox, &QCheckBox::stateChanged, win, [win] (int checked) {
+            win->setIndexCache (checked == Qt::Checked);
+        });
+
+        /* compression of encrypted documents */
+        static const int compressionLevels[] = {0, 1, 6, 9};
+        int compressionIndex = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (compressionLevels[i] <= win->getCompressionLevel())
+                compressionIndex = i;
+        }
+        ui->compressionCombo->setCurrentIndex (compressionIndex);
+        connect (ui->compressionCombo, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), win, [win] (int index) {
+            win->setCompressionLevel (compressionLevels[qBound (0, index, 3)]);
+        });
+
+        /* flushing to disk */
+        ui->syncCombo->setCurrentIndex (win->getSyncPolicy());
+        connect (ui->syncCombo, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), win, [win] (int index) {
+            win->setSyncPolicy (index);
+        });
+
         /*****************
          *** Shortcuts ***
          *****************/
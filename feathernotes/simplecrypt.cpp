@@ -26,15 +26,60 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "simplecrypt.h"
+#include "decryptchain.h"
 #include <QByteArray>
 #include <QtDebug>
 #include <QtGlobal>
 #include <QDateTime>
 #include <QCryptographicHash>
 #include <QDataStream>
+#include <string.h>
 
 namespace FeatherNotes {
 
+/* decodes complete base64 quartets and returns the number of written bytes
+   (-1 if a character isn't in the alphabet or the padding is misplaced) */
+static int decodeBase64(const char *in, int size, char *out, bool isEnd)
+{
+    static const struct Table {
+        signed char values[256];
+        Table() {
+            memset(values, -1, sizeof(values));
+            const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            for (int i = 0; i < 64; ++i)
+                values[static_cast<uchar>(alphabet[i])] = static_cast<signed char>(i);
+        }
+    } base64Table;
+    const signed char *table = base64Table.values;
+
+    const uchar *p = reinterpret_cast<const uchar*>(in);
+    char *o = out;
+    for (int i = 0; i < size; i += 4) {
+        const int a = table[p[i]];
+        const int b = table[p[i + 1]];
+        const int c = table[p[i + 2]];
+        const int d = table[p[i + 3]];
+        if ((a | b | c | d) >= 0) {
+            const quint32 v = (quint32(a) << 18) | (quint32(b) << 12) | (quint32(c) << 6) | quint32(d);
+            o[0] = char(v >> 16);
+            o[1] = char(v >> 8);
+            o[2] = char(v);
+            o += 3;
+            continue;
+        }
+        /* only the last quartet may be padded */
+        if (!isEnd || i + 4 != size || a < 0 || b < 0 || p[i + 3] != '=')
+            return -1;
+        const quint32 v = (quint32(a) << 18) | (quint32(b) << 12);
+        *o++ = char(v >> 16);
+        if (p[i + 2] != '=') {
+            if (c < 0) return -1;
+            *o++ = char((v | (quint32(c) << 6)) >> 8);
+        }
+    }
+    return static_cast<int>(o - out);
+}
+
 SimpleCrypt::SimpleCrypt():
     m_key(0),
     m_compressionMode(CompressionAuto),
@@ -206,43 +251,87 @@ QByteArray SimpleCrypt::decryptToByteArray(QByteArray cypher)
 
     CryptoFlags flags = CryptoFlags(ba.at(1));
 
-    ba = ba.mid(2);
-    int pos(0);
-    int cnt(ba.count());
-    char lastChar = 0;
+    decryptChain(ba.data() + 2, ba.count() - 2, 0, m_keyParts.constData(), 0);
 
-    while (pos < cnt) {
-        char currentChar = ba[pos];
-        ba[pos] = ba.at(pos) ^ lastChar ^ m_keyParts.at(pos % 8);
-        lastChar = currentChar;
-        ++pos;
+    return checkPlaintext(ba, 2, flags);
+}
+
+QByteArray SimpleCrypt::decryptBase64ToByteArray(const QByteArray& cypher)
+{
+    if (m_keyParts.isEmpty()) {
+        qWarning() << "No key set.";
+        m_lastError = ErrorNoKeySet;
+        return QByteArray();
     }
 
-    ba = ba.mid(1); //chop off the random number at the start
+    const int len = cypher.size();
+    if (len % 4 != 0)
+        return decryptToByteArray(QByteArray::fromBase64(cypher));
+
+    int padding = 0;
+    if (len > 0 && cypher.at(len - 1) == '=') {
+        ++padding;
+        if (len > 1 && cypher.at(len - 2) == '=')
+            ++padding;
+    }
+    const int cnt = len / 4 * 3 - padding;
+    if (cnt < 3)
+        return QByteArray();
+
+    /* decode and decrypt blocks that fit in the cache */
+    static const int blockSize = 65536; // a multiple of 4
+    QByteArray ba(cnt, Qt::Uninitialized);
+    char *out = ba.data();
+    const char *in = cypher.constData();
+    int written = 0;
+    char lastChar = 0;
+    for (int i = 0; i < len; i += blockSize) {
+        const int n = qMin(blockSize, len - i);
+        const int w = decodeBase64(in + i, n, out + written, i + n == len);
+        if (w < 0)
+            return decryptToByteArray(QByteArray::fromBase64(cypher));
+        if (written == 0 && out[0] != 3) { //we only work with version 3
+            m_lastError = ErrorUnknownVersion;
+            return QByteArray();
+        }
+        /* the version and flags aren't encrypted */
+        const int from = qMax(written, 2);
+        const int to = written + w;
+        if (to > from)
+            lastChar = decryptChain(out + from, to - from, lastChar, m_keyParts.constData(), from - 2);
+        written = to;
+    }
+    if (written != cnt)
+        return QByteArray();
+
+    return checkPlaintext(ba, 2, CryptoFlags(ba.at(1)));
+}
+
+/* checks the decrypted data that begins at "start" and returns the plaintext */
+QByteArray SimpleCrypt::checkPlaintext(const QByteArray& ba, int start, CryptoFlags flags)
+{
+    int pos = start + 1; //skip the random number at the start
 
     bool integrityOk(true);
     if (flags.testFlag(CryptoFlagChecksum)) {
-        if (ba.length() < 2) {
+        if (ba.length() - pos < 2) {
             m_lastError = ErrorIntegrityFailed;
             return QByteArray();
         }
-        quint16 storedChecksum;
-        {
-            QDataStream s(&ba, QIODevice::ReadOnly);
-            s >> storedChecksum;
-        }
-        ba = ba.mid(2);
-        quint16 checksum = qChecksum(ba.constData(), static_cast<uint>(ba.length()));
+        //stored with QDataStream, i.e., in big endian
+        const quint16 storedChecksum = quint16((uchar(ba.at(pos)) << 8) | uchar(ba.at(pos + 1)));
+        pos += 2;
+        quint16 checksum = qChecksum(ba.constData() + pos, static_cast<uint>(ba.length() - pos));
         integrityOk = (checksum == storedChecksum);
     } else if (flags.testFlag(CryptoFlagHash)) {
-        if (ba.length() < 20) {
+        if (ba.length() - pos < 20) {
             m_lastError = ErrorIntegrityFailed;
             return QByteArray();
         }
-        QByteArray storedHash = ba.left(20);
-        ba = ba.mid(20);
+        QByteArray storedHash = ba.mid(pos, 20);
+        pos += 20;
         QCryptographicHash hash(QCryptographicHash::Sha1);
-        hash.addData(ba);
+        hash.addData(ba.constData() + pos, ba.length() - pos);
         integrityOk = (hash.result() == storedHash);
     }
 
@@ -251,11 +340,10 @@ QByteArray SimpleCrypt::decryptToByteArray(QByteArray cypher)
         return QByteArray();
     }
 
-    if (flags.testFlag(CryptoFlagCompression))
-        ba = qUncompress(ba);
-
     m_lastError = ErrorNoError;
-    return ba;
+    if (flags.testFlag(CryptoFlagCompression))
+        return qUncompress(reinterpret_cast<const uchar*>(ba.constData() + pos), ba.length() - pos);
+    return ba.mid(pos);
 }
 
 }
@@ -204,6 +204,14 @@ public:
       an empty string or a string containing nonsense may be returned.
       */
     QByteArray decryptToByteArray(QByteArray cypher) ;
+    /**
+      Decrypts a base64 encoded cyphertext, like decryptToByteArray(QByteArray::fromBase64(cypher)),
+      but decodes and decrypts the data block by block while it is in the cache.
+
+      If the cyphertext contains characters other than those of the base64 alphabet
+      (like line breaks), it falls back to decoding the whole data first.
+      */
+    QByteArray decryptBase64ToByteArray(const QByteArray& cypher) ;
 
     //enum to describe options that have been used for the encryption. Currently only one, but
     //that only leaves room for future extensions like adding a cryptographic hash...
@@ -216,6 +224,7 @@ public:
 private:
 
     void splitKey();
+    QByteArray checkPlaintext(const QByteArray& ba, int start, CryptoFlags flags) ;
 
     quint64 m_key;
     QVector<char> m_keyParts;
@@ -0,0 +1,577 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QThread>
+#include <QThreadStorage>
+#include <QAtomicInt>
+#include <QDataStream>
+#include <QDomElement>
+#include <QDomNamedNodeMap>
+#include <QRegularExpression>
+#include "sqlitenotebook.h"
+#include "dommodel.h"
+#include "domitem.h"
+
+namespace FeatherNotes {
+
+static const int NOTEBOOK_VERSION = 1;
+
+typedef QVector<QPair<QString, QString> > Attributes;
+
+SqliteNotebook::SqliteNotebook (const QString &filePath) :
+    Notebook (filePath),
+    thread_ (QThread::currentThread()),
+    hasFts_ (false)
+{
+    static QAtomicInt count;
+    connection_ = QString ("fnnotebook%1").arg (count.fetchAndAddRelaxed (1));
+}
+/*************************/
+SqliteNotebook::~SqliteNotebook()
+{
+    if (QSqlDatabase::contains (connection_))
+    {
+        QSqlDatabase::database (connection_, false).close();
+        QSqlDatabase::removeDatabase (connection_);
+    }
+}
+/*************************/
+bool SqliteNotebook::isSqlite (QIODevice *device)
+{
+    return device->peek (16) == QByteArray ("SQLite format 3\0", 16);
+}
+/*************************/
+// The connection of the thread of the notebook. A connection can be used
+// (and should be closed) only in the thread that has made it.
+QSqlDatabase SqliteNotebook::database() const
+{
+    if (QSqlDatabase::contains (connection_))
+        return QSqlDatabase::database (connection_);
+    QSqlDatabase db = QSqlDatabase::addDatabase ("QSQLITE", connection_);
+    db.setDatabaseName (filePath_);
+    db.open();
+    return db;
+}
+/*************************/
+// The connections that a thread other than that of a notebook has made for
+// reading. They're closed and removed in the same thread when it finishes, and
+// their names are unique, because thread pointers may be reused.
+class ThreadConnections
+{
+public:
+    ThreadConnections() {
+        static QAtomicInt count;
+        suffix_ = QString ("-%1").arg (count.fetchAndAddRelaxed (1));
+    }
+    ~ThreadConnections() {
+        for (const QString &name : names_)
+        {
+            QSqlDatabase::database (name, false).close();
+            QSqlDatabase::removeDatabase (name);
+        }
+    }
+    QSqlDatabase database (const QString &prefix, const QString &filePath) {
+        const QString name = prefix + suffix_;
+        if (names_.contains (name))
+            return QSqlDatabase::database (name, false);
+        names_.insert (name);
+        QSqlDatabase db = QSqlDatabase::addDatabase ("QSQLITE", name);
+        db.setDatabaseName (filePath);
+        db.open();
+        return db;
+    }
+
+private:
+    QString suffix_;
+    QSet<QString> names_;
+};
+
+static QThreadStorage<ThreadConnections*> threadConnections;
+/*************************/
+bool SqliteNotebook::exec (const QString &statement)
+{
+    QSqlQuery query (database());
+    if (query.exec (statement))
+        return true;
+    errorString_ = query.lastError().text();
+    return false;
+}
+/*************************/
+bool SqliteNotebook::createTables()
+{
+    if (!exec ("CREATE TABLE IF NOT EXISTS meta (name TEXT PRIMARY KEY, value TEXT)")
+        || !exec ("CREATE TABLE IF NOT EXISTS nodes (id INTEGER PRIMARY KEY, parent INTEGER,"
+                  " position INTEGER NOT NULL, name TEXT, tag TEXT, icon TEXT,"
+                  " attributes BLOB, body TEXT)")
+        || !exec ("CREATE INDEX IF NOT EXISTS nodes_parent ON nodes (parent, position)")
+        || !exec ("CREATE TABLE IF NOT EXISTS images (id TEXT PRIMARY KEY, data BLOB)")
+        || !exec (QString ("PRAGMA user_version = %1").arg (NOTEBOOK_VERSION)))
+    {
+        return false;
+    }
+    /* the trigram tokenizer finds parts of words, as the search bar does,
+       but SQLite may be built without FTS5 or be older than 3.34 */
+    hasFts_ = exec ("CREATE VIRTUAL TABLE IF NOT EXISTS search USING fts5 (body, tokenize = 'trigram')");
+    errorString_.clear();
+    return true;
+}
+/*************************/
+struct NodeRow
+{
+    qint64 id;
+    QString name;
+    QString tag;
+    QString icon;
+    QByteArray attributes;
+    bool hasText;
+};
+
+static void addRows (QDomDocument &doc, QDomElement &parentElement, qint64 parent,
+                     const QHash<qint64, QVector<NodeRow> > &children,
+                     QVector<TextRange> &ranges, QVector<qint64> &order, QSet<qint64> &added)
+{
+    const QVector<NodeRow> rows = children.value (parent);
+    for (const NodeRow &row : rows)
+    {
+        if (added.contains (row.id)) continue; // the tree is broken
+        added.insert (row.id);
+
+        QDomElement e = doc.createElement ("node");
+        if (!row.name.isNull())
+            e.setAttribute ("name", row.name);
+        if (!row.tag.isNull())
+            e.setAttribute ("tag", row.tag);
+        if (!row.icon.isNull())
+            e.setAttribute ("icon", row.icon);
+        if (!row.attributes.isEmpty())
+        {
+            Attributes attributes;
+            QDataStream in (row.attributes);
+            in.setVersion (QDataStream::Qt_5_0);
+            in >> attributes;
+            for (const auto &attr : attributes)
+                e.setAttribute (attr.first, attr.second);
+        }
+        parentElement.appendChild (e);
+
+        TextRange range;
+        range.offset = row.hasText ? row.id : -1;
+        range.length = row.hasText ? 1 : 0;
+        ranges << range;
+        order << row.id;
+
+        addRows (doc, e, row.id, children, ranges, order, added);
+    }
+}
+/*************************/
+bool SqliteNotebook::read (QDomDocument &doc, QVector<TextRange> &ranges)
+{
+    errorString_.clear();
+    ranges.clear();
+    order_.clear();
+    QSqlDatabase db = database();
+    if (!db.isOpen())
+    {
+        errorString_ = db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query (db);
+    if (!query.exec ("PRAGMA user_version") || !query.next()
+        || query.value (0).toInt() > NOTEBOOK_VERSION)
+    {
+        errorString_ = "Unsupported notebook version.";
+        return false;
+    }
+    if (!query.exec ("SELECT name, value FROM meta"))
+    {
+        errorString_ = query.lastError().text();
+        return false;
+    }
+    QDomElement root = doc.createElement ("feathernotes");
+    doc.appendChild (root);
+    while (query.next())
+        root.setAttribute (query.value (0).toString(), query.value (1).toString());
+
+    if (!query.exec ("SELECT id, IFNULL(parent, 0), name, tag, icon, attributes, length(body) > 0"
+                     " FROM nodes ORDER BY parent, position"))
+    {
+        errorString_ = query.lastError().text();
+        doc = QDomDocument();
+        return false;
+    }
+    QHash<qint64, QVector<NodeRow> > children;
+    while (query.next())
+    {
+        NodeRow row;
+        row.id = query.value (0).toLongLong();
+        row.name = query.value (2).toString();
+        row.tag = query.value (3).toString();
+        row.icon = query.value (4).toString();
+        row.attributes = query.value (5).toByteArray();
+        row.hasText = query.value (6).toBool();
+        children[query.value (1).toLongLong()] << row;
+    }
+    QSet<qint64> added;
+    addRows (doc, root, 0, children, ranges, order_, added);
+
+    if (query.exec ("SELECT id, data FROM images"))
+    {
+        QDomElement images = doc.createElement ("images");
+        while (query.next())
+        {
+            QDomElement e = doc.createElement ("image");
+            e.setAttribute ("id", query.value (0).toString());
+            e.appendChild (doc.createTextNode (QString::fromLatin1 (query.value (1).toByteArray().toBase64())));
+            images.appendChild (e);
+        }
+        if (images.hasChildNodes())
+            root.appendChild (images);
+    }
+
+    unindexed_.clear();
+    hasFts_ = query.exec ("SELECT count(*) FROM sqlite_master WHERE name = 'search'")
+              && query.next() && query.value (0).toInt() > 0;
+    if (hasFts_ && query.exec ("SELECT id FROM nodes WHERE length(body) > 0"
+                               " AND id NOT IN (SELECT rowid FROM search)"))
+    {
+        while (query.next())
+            unindexed_.insert (query.value (0).toLongLong());
+    }
+    return true;
+}
+/*************************/
+static QString readBody (const QSqlDatabase &db, qint64 id)
+{
+    QSqlQuery query (db);
+    query.prepare ("SELECT body FROM nodes WHERE id = ?");
+    query.addBindValue (id);
+    if (query.exec() && query.next())
+        return query.value (0).toString();
+    return QString();
+}
+
+QString SqliteNotebook::text (qint64 offset, qint64 /*length*/) const
+{
+    if (QThread::currentThread() == thread_)
+        return readBody (database(), offset);
+
+    /* other threads (as in prefetching and searching) read through
+       connections of their own, which are kept until they finish */
+    if (!threadConnections.hasLocalData())
+        threadConnections.setLocalData (new ThreadConnections);
+    return readBody (threadConnections.localData()->database (connection_, filePath_), offset);
+}
+/*************************/
+// The plain text is indexed only if it's the same as what the search bar finds in.
+bool SqliteNotebook::writeText (qint64 id, const QString &text)
+{
+    QSqlQuery query (database());
+    query.prepare ("UPDATE nodes SET body = ? WHERE id = ?");
+    query.addBindValue (text);
+    query.addBindValue (id);
+    if (!query.exec())
+    {
+        errorString_ = query.lastError().text();
+        return false;
+    }
+    if (!hasFts_) return true;
+
+    query.prepare ("DELETE FROM search WHERE rowid = ?");
+    query.addBindValue (id);
+    if (!query.exec())
+    {
+        errorString_ = query.lastError().text();
+        return false;
+    }
+    bool exact;
+    QString plain = TextIndex::plainText (text, &exact);
+    if (!exact)
+    {
+        unindexed_.insert (id);
+        return true;
+    }
+    unindexed_.remove (id);
+    if (plain.isEmpty()) return true;
+    plain.replace (QChar::Nbsp, QLatin1Char (' '));
+    query.prepare ("INSERT INTO search (rowid, body) VALUES (?, ?)");
+    query.addBindValue (id);
+    query.addBindValue (plain);
+    if (!query.exec())
+    {
+        errorString_ = query.lastError().text();
+        return false;
+    }
+    return true;
+}
+/*************************/
+bool SqliteNotebook::saveTexts (const QList<DomItem*> &items)
+{
+    errorString_.clear();
+    QSqlDatabase db = database();
+    if (!db.transaction())
+    {
+        errorString_ = db.lastError().text();
+        return false;
+    }
+    const QHash<DomItem*, Row> oldRows = rows_;
+    const QSet<qint64> oldUnindexed = unindexed_;
+    for (DomItem *item : items)
+    {
+        QHash<DomItem*, Row>::iterator it = rows_.find (item);
+        /* a new node needs the structure to be saved */
+        bool ok = it != rows_.end();
+        if (ok && it.value().generation != item->textGeneration())
+        {
+            ok = writeText (it.value().id, item->text());
+            it.value().generation = item->textGeneration();
+        }
+        if (!ok)
+        {
+            db.rollback();
+            rows_ = oldRows;
+            unindexed_ = oldUnindexed;
+            return false;
+        }
+    }
+    if (db.commit())
+        return true;
+    errorString_ = db.lastError().text();
+    db.rollback();
+    rows_ = oldRows;
+    unindexed_ = oldUnindexed;
+    return false;
+}
+/*************************/
+bool SqliteNotebook::writeItem (DomItem *item, qint64 parent, int position, QSet<qint64> &kept)
+{
+    QString name, tag, icon;
+    Attributes others;
+    const QDomNamedNodeMap attributes = item->node().attributes();
+    for (int i = 0; i < attributes.count(); ++i)
+    {
+        const QDomNode attr = attributes.item (i);
+        const QString value = attr.nodeValue().isNull() ? QString ("") : attr.nodeValue();
+        if (attr.nodeName() == "name")
+            name = value;
+        else if (attr.nodeName() == "tag")
+            tag = value;
+        else if (attr.nodeName() == "icon")
+            icon = value;
+        else
+            others << qMakePair (attr.nodeName(), value);
+    }
+    QByteArray otherData;
+    if (!others.isEmpty())
+    {
+        QDataStream out (&otherData, QIODevice::WriteOnly);
+        out.setVersion (QDataStream::Qt_5_0);
+        out << others;
+    }
+
+    QSqlQuery query (database());
+    QHash<DomItem*, Row>::iterator it = rows_.find (item);
+    if (it != rows_.end())
+    {
+        query.prepare ("UPDATE nodes SET parent = ?, position = ?, name = ?, tag = ?,"
+                       " icon = ?, attributes = ? WHERE id = ?");
+    }
+    else
+    {
+        query.prepare ("INSERT INTO nodes (parent, position, name, tag, icon, attributes)"
+                       " VALUES (?, ?, ?, ?, ?, ?)");
+    }
+    query.addBindValue (parent > 0 ? QVariant (parent) : QVariant (QVariant::LongLong));
+    query.addBindValue (position);
+    query.addBindValue (name);
+    query.addBindValue (tag);
+    query.addBindValue (icon);
+    query.addBindValue (otherData);
+    if (it != rows_.end())
+        query.addBindValue (it.value().id);
+    if (!query.exec())
+    {
+        errorString_ = query.lastError().text();
+        return false;
+    }
+
+    if (it == rows_.end())
+    {
+        Row row;
+        row.id = query.lastInsertId().toLongLong();
+        row.generation = item->textGeneration();
+        it = rows_.insert (item, row);
+        items_.insert (row.id, item);
+        if (!writeText (row.id, item->text()))
+            return false;
+    }
+    else if (it.value().generation != item->textGeneration())
+    { // the text isn't read if it isn't changed
+        if (!writeText (it.value().id, item->text()))
+            return false;
+        it.value().generation = item->textGeneration();
+    }
+    const qint64 id = it.value().id;
+    kept.insert (id);
+
+    for (int i = 0; i < item->childCount(); ++i)
+    {
+        if (!writeItem (item->child (i), id, i, kept))
+            return false;
+    }
+    return true;
+}
+/*************************/
+bool SqliteNotebook::saveAll (DomModel *model)
+{
+    errorString_.clear();
+    QSqlDatabase db = database();
+    if (!db.isOpen())
+    {
+        errorString_ = db.lastError().text();
+        return false;
+    }
+    if (!createTables()) return false;
+    if (!db.transaction())
+    {
+        errorString_ = db.lastError().text();
+        return false;
+    }
+    const QHash<DomItem*, Row> oldRows = rows_;
+    const QSet<qint64> oldUnindexed = unindexed_;
+
+    bool ok = exec ("DELETE FROM meta");
+    QSqlQuery query (db);
+    const QDomNamedNodeMap rootAttributes = model->domDocument.firstChildElement ("feathernotes").attributes();
+    for (int i = 0; ok && i < rootAttributes.count(); ++i)
+    {
+        const QDomNode attr = rootAttributes.item (i);
+        query.prepare ("INSERT INTO meta (name, value) VALUES (?, ?)");
+        query.addBindValue (attr.nodeName());
+        query.addBindValue (attr.nodeValue());
+        ok = query.exec();
+    }
+
+    QSet<qint64> kept;
+    DomItem *rootItem = model->rootItem();
+    for (int i = 0; ok && i < rootItem->childCount(); ++i)
+        ok = writeItem (rootItem->child (i), 0, i, kept);
+
+    /* remove the rows of removed nodes */
+    QList<qint64> removed;
+    if (ok && (ok = query.exec ("SELECT id FROM nodes")))
+    {
+        while (query.next())
+        {
+            const qint64 id = query.value (0).toLongLong();
+            if (!kept.contains (id))
+                removed << id;
+        }
+    }
+    for (int i = 0; ok && i < removed.count(); ++i)
+    {
+        query.prepare ("DELETE FROM nodes WHERE id = ?");
+        query.addBindValue (removed.at (i));
+        ok = query.exec();
+        if (ok && hasFts_)
+        {
+            query.prepare ("DELETE FROM search WHERE rowid = ?");
+            query.addBindValue (removed.at (i));
+            ok = query.exec();
+        }
+        unindexed_.remove (removed.at (i));
+    }
+
+    /* only new images are written */
+    const QHash<QString, QByteArray> images = model->imageStore.encodedImages();
+    QSet<QString> stored;
+    if (ok && (ok = query.exec ("SELECT id FROM images")))
+    {
+        while (query.next())
+            stored.insert (query.value (0).toString());
+    }
+    QHash<QString, QByteArray>::const_iterator img = images.constBegin();
+    for (; ok && img != images.constEnd(); ++img)
+    {
+        if (stored.remove (img.key())) continue;
+        query.prepare ("INSERT INTO images (id, data) VALUES (?, ?)");
+        query.addBindValue (img.key());
+        query.addBindValue (QByteArray::fromBase64 (img.value()));
+        ok = query.exec();
+    }
+    for (const QString &id : stored)
+    {
+        if (!ok) break;
+        query.prepare ("DELETE FROM images WHERE id = ?");
+        query.addBindValue (id);
+        ok = query.exec();
+    }
+
+    if (ok && db.commit())
+    {
+        keepRows (kept);
+        return true;
+    }
+    if (errorString_.isEmpty())
+        errorString_ = query.lastError().isValid() ? query.lastError().text() : db.lastError().text();
+    db.rollback();
+    setRows (oldRows);
+    unindexed_ = oldUnindexed;
+    return false;
+}
+/*************************/
+bool SqliteNotebook::isIndexed (DomItem *item) const
+{
+    if (!hasFts_) return false;
+    QHash<DomItem*, Row>::const_iterator it = rows_.constFind (item);
+    return it != rows_.constEnd()
+           && it.value().generation == item->textGeneration()
+           && !unindexed_.contains (it.value().id);
+}
+/*************************/
+// Each word of the string should be a part of an indexed text. Since a trigram
+// can't be made from shorter words, they're left to the real search.
+bool SqliteNotebook::candidates (const QString &str, QSet<DomItem*> &items) const
+{
+    if (!hasFts_) return false;
+    QStringList terms;
+    static const QRegularExpression word ("\\S+");
+    QRegularExpressionMatchIterator it = word.globalMatch (QString (str).replace (QChar::Nbsp, QLatin1Char (' ')));
+    while (it.hasNext())
+    {
+        QString term = it.next().captured();
+        if (term.length() < 3) continue;
+        term.replace ("\"", "\"\"");
+        terms << "\"" + term + "\"";
+    }
+    if (terms.isEmpty()) return false;
+
+    QSqlQuery query (database());
+    query.prepare ("SELECT rowid FROM search WHERE search MATCH ?");
+    query.addBindValue (terms.join (" AND "));
+    if (!query.exec()) return false;
+    while (query.next())
+    {
+        if (DomItem *item = items_.value (query.value (0).toLongLong()))
+            items.insert (item);
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SQLITENOTEBOOK_H
+#define SQLITENOTEBOOK_H
+
+#include <QIODevice>
+#include <QSqlDatabase>
+#include <QThread>
+#include "notebook.h"
+#include "textindex.h"
+
+namespace FeatherNotes {
+
+// A document that is kept in an SQLite database, where each node is a row.
+// Node texts are read from the database only when they are needed, and saving
+// writes only what has changed, inside a transaction. An FTS5 table of plain
+// texts is used by the search index if SQLite supports it.
+//
+// As a text source, it's thread-safe because other threads read node texts
+// through connections of their own, which are closed when the threads finish.
+class SqliteNotebook : public Notebook, public FullTextSearch
+{
+public:
+    SqliteNotebook (const QString &filePath);
+    ~SqliteNotebook();
+
+    /* whether the device contains an SQLite database */
+    static bool isSqlite (QIODevice *device);
+    /* the files of notebooks are recognized by their extension on saving */
+    static bool isNotebookPath (const QString &filePath) {
+        return filePath.endsWith (".fndb");
+    }
+
+    bool read (QDomDocument &doc, QVector<TextRange> &ranges);
+    bool saveTexts (const QList<DomItem*> &items);
+    bool saveAll (DomModel *model);
+
+    /* the offset of a text is the row of its node */
+    QString text (qint64 offset, qint64 length) const;
+
+    bool isIndexed (DomItem *item) const;
+    bool candidates (const QString &str, QSet<DomItem*> &items) const;
+
+private:
+    QSqlDatabase database() const;
+    bool exec (const QString &statement);
+    bool createTables();
+    bool writeText (qint64 id, const QString &text);
+    bool writeItem (DomItem *item, qint64 parent, int position, QSet<qint64> &kept);
+
+    QThread *thread_; // The thread that uses the main connection.
+    QString connection_; // The name of the main connection (and the prefix of others).
+    bool hasFts_;
+    QSet<qint64> unindexed_; // The rows whose texts aren't in the FTS5 table.
+};
+
+}
+
+#endif // SQLITENOTEBOOK_H
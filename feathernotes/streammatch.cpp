@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "streammatch.h"
+#include <QTextBlock>
+#include <QVector>
+#include <algorithm>
+
+namespace FeatherNotes {
+
+/*************************************************************************
+ ***** A string with line breaks is searched for in the stream of    *****
+ ***** block texts, joined by newlines, with the Knuth-Morris-Pratt  *****
+ ***** algorithm. In this way, every character is visited only once. *****
+ *************************************************************************/
+class StreamMatcher
+{
+public:
+    StreamMatcher (const QString &str, Qt::CaseSensitivity cs) : cs_ (cs), matched_ (0)
+    {
+        pattern_.reserve (str.length());
+        for (const QChar &c : str)
+            pattern_.append (fold (c));
+        /* the length of the longest proper prefix of each
+           prefix of the pattern that is also its suffix */
+        failure_.resize (pattern_.length());
+        failure_[0] = 0;
+        int k = 0;
+        for (int i = 1; i < pattern_.length(); ++i)
+        {
+            while (k > 0 && pattern_.at (i) != pattern_.at (k))
+                k = failure_.at (k - 1);
+            if (pattern_.at (i) == pattern_.at (k))
+                ++k;
+            failure_[i] = k;
+        }
+    }
+
+    /* feeds the next character of the stream and
+       returns true if a match ends with it */
+    bool feed (QChar c)
+    {
+        c = fold (c);
+        while (matched_ > 0 && pattern_.at (matched_) != c)
+            matched_ = failure_.at (matched_ - 1);
+        if (pattern_.at (matched_) == c)
+            ++matched_;
+        if (matched_ == pattern_.length())
+        {
+            matched_ = failure_.at (matched_ - 1);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    QChar fold (QChar c) const
+    {
+        if (c == QChar::Nbsp)
+            c = QLatin1Char (' ');
+        return cs_ == Qt::CaseSensitive ? c : c.toCaseFolded();
+    }
+
+    Qt::CaseSensitivity cs_;
+    QString pattern_;
+    QVector<int> failure_;
+    int matched_;
+};
+
+/* A line break at the start or end of the string is a word boundary by
+   itself, as with the empty first or last line of the per-line search. */
+static bool isWholeWord (const QTextDocument *txtdoc, const QString &str, int start, int end)
+{
+    return (str.startsWith (QLatin1Char ('\n')) || start == 0
+            || !txtdoc->characterAt (start - 1).isLetterOrNumber())
+           && (str.endsWith (QLatin1Char ('\n'))
+               || !txtdoc->characterAt (end).isLetterOrNumber());
+}
+
+static QTextCursor selection (QTextDocument *txtdoc, int start, int end)
+{
+    QTextCursor cursor (txtdoc);
+    cursor.setPosition (start);
+    cursor.setPosition (end, QTextCursor::KeepAnchor);
+    return cursor;
+}
+/*************************/
+QTextCursor findForwardInStream (QTextDocument *txtdoc, const QString &str, int from,
+                                 QTextDocument::FindFlags flags)
+{
+    if (str.isEmpty())
+        return QTextCursor();
+    StreamMatcher matcher (str, !(flags & QTextDocument::FindCaseSensitively)
+                                ? Qt::CaseInsensitive : Qt::CaseSensitive);
+    QTextBlock block = txtdoc->findBlock (from);
+    int offset = from - block.position();
+    while (block.isValid())
+    {
+        const QString text = block.text();
+        const bool hasNext = block.next().isValid();
+        for (int i = offset; i < text.length() || (hasNext && i == text.length()); ++i)
+        {
+            if (matcher.feed (i < text.length() ? text.at (i) : QChar (QLatin1Char ('\n'))))
+            {
+                const int end = block.position() + i + 1;
+                const int start = end - str.length();
+                if (!(flags & QTextDocument::FindWholeWords) || isWholeWord (txtdoc, str, start, end))
+                    return selection (txtdoc, start, end);
+            }
+        }
+        block = block.next();
+        offset = 0;
+    }
+    return QTextCursor();
+}
+/*************************/
+QTextCursor findBackwardInStream (QTextDocument *txtdoc, const QString &str, int to,
+                                  QTextDocument::FindFlags flags)
+{
+    if (str.isEmpty())
+        return QTextCursor();
+    QString reversed = str;
+    std::reverse (reversed.begin(), reversed.end());
+    StreamMatcher matcher (reversed, !(flags & QTextDocument::FindCaseSensitively)
+                                     ? Qt::CaseInsensitive : Qt::CaseSensitive);
+    QTextBlock block = txtdoc->findBlock (to);
+    int offset = to - block.position();
+    while (block.isValid())
+    {
+        const QString text = block.text();
+        const bool hasPrevious = block.previous().isValid();
+        for (int i = offset - 1; i >= 0 || (hasPrevious && i == -1); --i)
+        {
+            /* the newline before a block is the end of the previous one */
+            if (matcher.feed (i >= 0 ? text.at (i) : QChar (QLatin1Char ('\n'))))
+            {
+                const int start = block.position() + i;
+                const int end = start + str.length();
+                if (!(flags & QTextDocument::FindWholeWords) || isWholeWord (txtdoc, str, start, end))
+                    return selection (txtdoc, start, end);
+            }
+        }
+        block = block.previous();
+        offset = block.length() - 1; // newline is included in QTextBlock::length()
+    }
+    return QTextCursor();
+}
+
+}
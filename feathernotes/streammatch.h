@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STREAMMATCH_H
+#define STREAMMATCH_H
+
+#include <QTextDocument>
+#include <QTextCursor>
+
+namespace FeatherNotes {
+
+/* Find a string with line breaks in the stream of block texts, joined by
+   newlines, and return its selection or a null cursor. The forward search
+   finds the first match that starts at or after "from" and the backward
+   search finds the last match that ends at or before "to". */
+QTextCursor findForwardInStream (QTextDocument *txtdoc, const QString &str, int from,
+                                 QTextDocument::FindFlags flags);
+QTextCursor findBackwardInStream (QTextDocument *txtdoc, const QString &str, int to,
+                                  QTextDocument::FindFlags flags);
+
+}
+
+#endif // STREAMMATCH_H
@@ -43,6 +43,8 @@ TextEdit::TextEdit (QWidget *parent) : QTextEdit (parent)
     textTab_ = "    "; // the default text tab is four spaces
     pressPoint = QPoint();
     scrollJumpWorkaround = false;
+    imageStore = nullptr;
+    storeNewImages = false;
     scrollTimer_ = nullptr;
 
     VScrollBar *vScrollBar = new VScrollBar;
@@ -688,6 +690,17 @@ bool TextEdit::event (QEvent *e)
     return QTextEdit::event (e);
 }
 /*************************/
+QVariant TextEdit::loadResource (int type, const QUrl &name)
+{
+    if (type == QTextDocument::ImageResource && imageStore)
+    {
+        const QString id = ImageStore::idOf (name);
+        if (!id.isEmpty())
+            return imageStore->image (id);
+    }
+    return QTextEdit::loadResource (type, name);
+}
+/*************************/
 bool TextEdit::canInsertFromMimeData (const QMimeData *source) const
 {
     if (source->hasImage() || source->hasUrls())
@@ -709,8 +722,17 @@ void TextEdit::insertFromMimeData (const QMimeData *source)
             image.save (&buffer, "PNG");
             buffer.close();
 
-            insertHtml (QString ("<img src=\"data:image;base64,%1\" />")
-                        .arg (QString (rawarray.toBase64())));
+            if (imageStore && storeNewImages)
+            {
+                const QString id = imageStore->add (rawarray);
+                document()->addResource (QTextDocument::ImageResource, QUrl (ImageStore::url (id)), image);
+                insertHtml (QString ("<img src=\"%1\" />").arg (ImageStore::url (id)));
+            }
+            else
+            {
+                insertHtml (QString ("<img src=\"data:image;base64,%1\" />")
+                            .arg (QString (rawarray.toBase64())));
+            }
         }
     }
     else if (source->hasUrls())
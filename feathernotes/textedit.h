@@ -26,6 +26,7 @@
 #include <QMimeData>
 #include <QElapsedTimer>
 #include "vscrollbar.h"
+#include "imagestore.h"
 
 namespace FeatherNotes {
 
@@ -48,6 +49,15 @@ public:
 
     void zooming (float range);
 
+    /* the store resolves image references and, if "storeNew" is true,
+       keeps pasted images (otherwise, they're embedded in the text) */
+    void setImageStore (ImageStore *store, bool storeNew)
+    {
+        imageStore = store;
+        storeNewImages = storeNew;
+    }
+    QVariant loadResource (int type, const QUrl &name);
+
     bool autoIndentation;
     bool autoBracket;
     bool autoReplace;
@@ -81,6 +91,8 @@ private:
     QString textTab_; // text tab in terms of spaces
     QPoint pressPoint;
     bool scrollJumpWorkaround; // for working around Qt5's scroll jump bug
+    ImageStore *imageStore;
+    bool storeNewImages;
     QElapsedTimer tripleClickTimer_;
     /****************************
      ***** Smooth scrolling *****
@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QFile>
+#include <QDataStream>
+#include <QVector>
+#include "textindex.h"
+#include "journal.h"
+#include "domitem.h"
+#include "atomicfile.h"
+
+namespace FeatherNotes {
+
+static const quint32 INDEX_MAGIC = 0x464e4931; // "FNI1"
+static const QSet<QString> BLOCK_TAGS = {"p", "br", "li", "div", "h1", "h2", "h3", "h4", "h5", "h6",
+                                         "td", "th", "tr", "pre", "hr", "blockquote"};
+
+TextIndex::TextIndex() : built_ (false), queryValid_ (false), allCandidates_ (true),
+                         ftsValid_ (false), ftsAll_ (true) {}
+/*************************/
+// Tags are removed, block ends become newlines and entities are decoded.
+// Line breaks of the HTML code itself aren't a part of the text.
+QString TextIndex::plainText (const QString &html, bool *ok)
+{
+    if (ok) *ok = true;
+    QString res;
+    int i = html.indexOf (QLatin1String ("<body"), 0, Qt::CaseInsensitive);
+    i = i == -1 ? 0 : html.indexOf ('>', i) + 1;
+    const int len = html.length();
+    res.reserve (len - i);
+    while (i < len)
+    {
+        const QChar c = html.at (i);
+        if (c == '<')
+        {
+            int end = html.indexOf ('>', i);
+            if (end == -1) break;
+            int start = i + 1;
+            if (start < end && html.at (start) == '/')
+                ++start;
+            int nameEnd = start;
+            while (nameEnd < end && html.at (nameEnd).isLetterOrNumber())
+                ++nameEnd;
+            if (BLOCK_TAGS.contains (html.mid (start, nameEnd - start).toLower()))
+            {
+                /* a block end or a line break (an opening block tag after an inline one
+                   is a new block too but an extra newline doesn't matter much) */
+                if (html.at (i + 1) == '/' || html.at (end - 1) == '/')
+                    res += '\n';
+                else if (!res.isEmpty() && !res.endsWith ('\n'))
+                    res += '\n';
+            }
+            i = end + 1;
+        }
+        else if (c == '&')
+        {
+            int end = html.indexOf (';', i);
+            if (end == -1 || end - i > 10)
+            {
+                res += c;
+                ++i;
+                continue;
+            }
+            const QString entity = html.mid (i + 1, end - i - 1);
+            if (entity == QLatin1String ("lt")) res += '<';
+            else if (entity == QLatin1String ("gt")) res += '>';
+            else if (entity == QLatin1String ("amp")) res += '&';
+            else if (entity == QLatin1String ("quot")) res += '"';
+            else if (entity == QLatin1String ("apos")) res += '\'';
+            else if (entity == QLatin1String ("nbsp")) res += ' ';
+            else if (entity.startsWith ('#'))
+            {
+                bool isNumber;
+                uint code = entity.startsWith (QLatin1String ("#x"), Qt::CaseInsensitive)
+                            ? entity.mid (2).toUInt (&isNumber, 16)
+                            : entity.mid (1).toUInt (&isNumber);
+                if (isNumber && code != 0)
+                {
+                    if (code == 0xa0)
+                        res += ' ';
+                    else
+                        res += QString::fromUcs4 (&code, 1);
+                }
+                else if (ok)
+                    *ok = false;
+            }
+            else
+            {
+                res += html.midRef (i, end - i + 1);
+                if (ok) *ok = false;
+            }
+            i = end + 1;
+        }
+        else
+        {
+            if (c == QChar::Nbsp)
+                res += ' ';
+            else if (c != '\n' && c != '\r')
+                res += c;
+            ++i;
+        }
+    }
+    while (res.endsWith ('\n'))
+        res.chop (1);
+    return res;
+}
+/*************************/
+QStringList TextIndex::words (const QString &foldedText)
+{
+    QSet<QString> set;
+    const int len = foldedText.length();
+    int start = -1;
+    for (int i = 0; i <= len; ++i)
+    {
+        if (i < len && foldedText.at (i).isLetterOrNumber())
+        {
+            if (start == -1) start = i;
+        }
+        else if (start != -1)
+        {
+            set.insert (foldedText.mid (start, i - start));
+            start = -1;
+        }
+    }
+    return set.values();
+}
+/*************************/
+void TextIndex::clear()
+{
+    built_ = false;
+    entries_.clear();
+    postings_.clear();
+    queryValid_ = false;
+}
+/*************************/
+void TextIndex::addEntry (DomItem *item, const Entry &entry)
+{
+    remove (item);
+    entries_.insert (item, entry);
+    for (const QString &word : entry.words)
+        postings_[word].insert (item);
+    queryValid_ = false;
+}
+/*************************/
+void TextIndex::update (DomItem *item, const QString &plainText, int stamp)
+{
+    Entry entry;
+    entry.words = words (plainText.toCaseFolded());
+    entry.stamp = stamp;
+    addEntry (item, entry);
+}
+/*************************/
+void TextIndex::remove (DomItem *item)
+{
+    QHash<DomItem*, Entry>::iterator it = entries_.find (item);
+    if (it == entries_.end()) return;
+    for (const QString &word : it.value().words)
+    {
+        QHash<QString, QSet<DomItem*> >::iterator p = postings_.find (word);
+        if (p != postings_.end())
+        {
+            p.value().remove (item);
+            if (p.value().isEmpty())
+                postings_.erase (p);
+        }
+    }
+    entries_.erase (it);
+    queryValid_ = false;
+}
+/*************************/
+int TextIndex::stamp (DomItem *item) const
+{
+    QHash<DomItem*, Entry>::const_iterator it = entries_.constFind (item);
+    if (it == entries_.constEnd())
+        return -2;
+    return it.value().stamp;
+}
+/*************************/
+// A word of the string may be at the start or end of the string; so, each word
+// of the string should only be a part of a word of the text.
+void TextIndex::setQuery (const QString &str) const
+{
+    if (queryValid_ && query_ == str) return;
+    query_ = str;
+    queryValid_ = true;
+    ftsValid_ = false;
+    candidates_.clear();
+
+    const QStringList strWords = words (str.toCaseFolded());
+    allCandidates_ = strWords.isEmpty();
+    for (int i = 0; i < strWords.count(); ++i)
+    {
+        const QString &strWord = strWords.at (i);
+        QSet<DomItem*> items;
+        QHash<QString, QSet<DomItem*> >::const_iterator it;
+        for (it = postings_.constBegin(); it != postings_.constEnd(); ++it)
+        {
+            if (it.key().contains (strWord))
+                items.unite (it.value());
+        }
+        if (i == 0)
+            candidates_ = items;
+        else
+            candidates_.intersect (items);
+        if (candidates_.isEmpty()) break;
+    }
+}
+/*************************/
+bool TextIndex::mayContain (DomItem *item, const QString &str) const
+{
+    if (!entries_.contains (item))
+    {
+        if (fullTextSearch_.isNull() || !fullTextSearch_->isIndexed (item))
+            return true;
+        setQuery (str);
+        if (!ftsValid_)
+        {
+            ftsValid_ = true;
+            ftsCandidates_.clear();
+            ftsAll_ = !fullTextSearch_->candidates (str, ftsCandidates_);
+        }
+        return ftsAll_ || ftsCandidates_.contains (item);
+    }
+    setQuery (str);
+    return allCandidates_ || candidates_.contains (item);
+}
+/*************************/
+void TextIndex::setFullTextSearch (const QSharedPointer<FullTextSearch> &search)
+{
+    fullTextSearch_ = search;
+    ftsValid_ = false;
+}
+/*************************/
+QString TextIndex::cachePath (const QString &filePath)
+{
+    return filePath + ".index";
+}
+/*************************/
+bool TextIndex::save (const QString &filePath, const QByteArray &fingerprint) const
+{
+    /* with a full-text search, only the edited texts are indexed here */
+    if (!built_ || fingerprint.isEmpty() || fullTextSearch_) return false;
+
+    AtomicFile file (cachePath (filePath), false);
+    if (!file.open()) return false;
+    QDataStream out (file.device());
+    out.setVersion (QDataStream::Qt_5_0);
+    out << INDEX_MAGIC << fingerprint << static_cast<quint32>(entries_.count());
+    QHash<DomItem*, Entry>::const_iterator it;
+    for (it = entries_.constBegin(); it != entries_.constEnd(); ++it)
+        out << Journal::itemPath (it.key()) << it.value().words;
+    if (out.status() != QDataStream::Ok)
+        return false;
+    return file.commit();
+}
+/*************************/
+bool TextIndex::load (const QString &filePath, const QByteArray &fingerprint, DomItem *rootItem)
+{
+    clear();
+    QFile file (cachePath (filePath));
+    if (fingerprint.isEmpty() || !file.open (QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in (&file);
+    in.setVersion (QDataStream::Qt_5_0);
+    quint32 magic, count;
+    QByteArray print;
+    in >> magic >> print >> count;
+    if (in.status() != QDataStream::Ok || magic != INDEX_MAGIC || print != fingerprint)
+        return false;
+
+    for (quint32 i = 0; i < count; ++i)
+    {
+        QVector<int> path;
+        Entry entry;
+        in >> path >> entry.words;
+        DomItem *item = in.status() == QDataStream::Ok ? Journal::itemAt (rootItem, path) : nullptr;
+        if (item == nullptr)
+        {
+            clear();
+            return false;
+        }
+        entry.stamp = -1;
+        addEntry (item, entry);
+    }
+    built_ = true;
+    return true;
+}
+
+}
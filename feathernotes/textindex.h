@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTINDEX_H
+#define TEXTINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QSharedPointer>
+
+namespace FeatherNotes {
+
+class DomItem;
+
+// A full-text index that is kept elsewhere (as in a database). It can rule
+// out the nodes whose texts aren't changed since they were indexed there.
+class FullTextSearch
+{
+public:
+    virtual ~FullTextSearch() {}
+
+    /* whether the current text of the node is indexed */
+    virtual bool isIndexed (DomItem *item) const = 0;
+    /* returns false if the candidates can't be found (all nodes are candidates then) */
+    virtual bool candidates (const QString &str, QSet<DomItem*> &items) const = 0;
+};
+
+// An inverted index from the (case-folded) words of node texts to their nodes.
+// It finds the nodes that may contain a string without reading node texts: a
+// node is a candidate only if each word of the string is a part of one of its
+// words. Nodes that aren't indexed are always candidates.
+class TextIndex
+{
+public:
+    TextIndex();
+
+    /* an approximation of QTextDocument::toPlainText() for node texts;
+       "ok" becomes false if the HTML has an unknown entity (the text
+       shouldn't be indexed then) */
+    static QString plainText (const QString &html, bool *ok = nullptr);
+
+    bool isBuilt() const {
+        return built_;
+    }
+    void setBuilt (bool built) {
+        built_ = built;
+    }
+    void clear();
+
+    /* the stamp can be used to know whether the indexed text is up to date */
+    void update (DomItem *item, const QString &plainText, int stamp = -1);
+    void remove (DomItem *item);
+    bool contains (DomItem *item) const {
+        return entries_.contains (item);
+    }
+    int stamp (DomItem *item) const;
+
+    bool mayContain (DomItem *item, const QString &str) const;
+
+    /* the nodes that aren't indexed here are looked up in a full-text search */
+    void setFullTextSearch (const QSharedPointer<FullTextSearch> &search);
+
+    /* the index can be cached beside a file with the fingerprint of the file */
+    static QString cachePath (const QString &filePath);
+    bool save (const QString &filePath, const QByteArray &fingerprint) const;
+    bool load (const QString &filePath, const QByteArray &fingerprint, DomItem *rootItem);
+
+private:
+    struct Entry {
+        QStringList words;
+        int stamp;
+    };
+
+    static QStringList words (const QString &foldedText);
+    void addEntry (DomItem *item, const Entry &entry);
+    void setQuery (const QString &str) const;
+
+    bool built_;
+    QHash<DomItem*, Entry> entries_;
+    QHash<QString, QSet<DomItem*> > postings_;
+    /* the candidates of the last string */
+    mutable QString query_;
+    mutable bool queryValid_;
+    mutable bool allCandidates_;
+    mutable QSet<DomItem*> candidates_;
+    QSharedPointer<FullTextSearch> fullTextSearch_;
+    mutable bool ftsValid_;
+    mutable bool ftsAll_;
+    mutable QSet<DomItem*> ftsCandidates_;
+};
+
+}
+
+#endif // TEXTINDEX_H
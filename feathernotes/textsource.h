@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTSOURCE_H
+#define TEXTSOURCE_H
+
+#include <QString>
+#include <QByteArray>
+
+namespace FeatherNotes {
+
+/* the place of a node's text in a source (a negative offset means no text) */
+struct TextRange
+{
+    qint64 offset;
+    qint64 length;
+};
+
+// A place from which the HTML texts of nodes can be read when they are needed,
+// so that they don't need to be kept in the DOM tree. A source is shared by
+// the items of a document and should remain valid as long as they exist.
+// Since documents may be saved in another thread, reading should be thread-safe.
+class TextSource
+{
+public:
+    virtual ~TextSource() {}
+
+    virtual QString text (qint64 offset, qint64 length) const = 0;
+
+    /* the text, encoded as it should be written into an FNX file, if the
+       source can give it without decoding (otherwise, a null byte array) */
+    virtual QByteArray xmlText (qint64 /*offset*/, qint64 /*length*/) const {
+        return QByteArray();
+    }
+
+    /* the text as it's stored in an FNB document, if the source is one
+       (otherwise, a null byte array); "compressed" is set if it's zlib-compressed */
+    virtual QByteArray fnbBody (qint64 /*offset*/, qint64 /*length*/, bool &/*compressed*/) const {
+        return QByteArray();
+    }
+};
+
+}
+
+#endif // TEXTSOURCE_H
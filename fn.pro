@@ -1,4 +1,5 @@
-SUBDIRS += feathernotes
+SUBDIRS += feathernotes \
+           tests
 
 TEMPLATE = subdirs 
 
@@ -0,0 +1,14 @@
+QT += core testlib
+QT -= gui
+
+TARGET = tst_fuzzymatch
+TEMPLATE = app
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../feathernotes
+
+SOURCES += tst_fuzzymatch.cpp \
+           ../../feathernotes/fuzzymatch.cpp
+
+HEADERS += ../../feathernotes/fuzzymatch.h
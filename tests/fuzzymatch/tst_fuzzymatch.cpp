@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fuzzymatch.h"
+#include <QtTest>
+
+using namespace FeatherNotes;
+
+class TestFuzzyMatch : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void matchAtStart();
+    void matchInMiddle();
+    void typoInMiddle();
+    void tooManyTypos();
+};
+
+void TestFuzzyMatch::matchAtStart()
+{
+    const QVector<FuzzyMatch> res = fuzzyFind ("hello world at the start", "hello world",
+                                               Qt::CaseInsensitive, 10);
+    QCOMPARE (res.count(), 1);
+    QCOMPARE (res.at (0).position, 0);
+    QCOMPARE (res.at (0).length, 11);
+    QCOMPARE (res.at (0).typos, 0);
+}
+
+void TestFuzzyMatch::matchInMiddle()
+{
+    const QString text ("some text, then Hello World and more");
+    const QVector<FuzzyMatch> res = fuzzyFind (text, "hello world", Qt::CaseInsensitive, 10);
+    QCOMPARE (res.count(), 1);
+    QCOMPARE (res.at (0).position, text.indexOf ("Hello"));
+    QCOMPARE (res.at (0).length, 11);
+    QCOMPARE (res.at (0).typos, 0);
+}
+
+void TestFuzzyMatch::typoInMiddle()
+{
+    const QString text ("some text, then helo world and more");
+    const QVector<FuzzyMatch> res = fuzzyFind (text, "hello world", Qt::CaseSensitive, 10);
+    QCOMPARE (res.count(), 1);
+    QCOMPARE (res.at (0).position, text.indexOf ("helo"));
+    QCOMPARE (res.at (0).length, 10);
+    QCOMPARE (res.at (0).typos, 1);
+}
+
+void TestFuzzyMatch::tooManyTypos()
+{
+    QVERIFY (fuzzyFind ("some text, then goodbye moon and more", "hello world",
+                        Qt::CaseSensitive, 10).isEmpty());
+    /* short patterns are found exactly */
+    QVERIFY (fuzzyFind ("a cot", "cat", Qt::CaseSensitive, 10).isEmpty());
+}
+
+QTEST_APPLESS_MAIN (TestFuzzyMatch)
+
+#include "tst_fuzzymatch.moc"
@@ -0,0 +1,16 @@
+QT += core testlib
+QT -= gui
+
+TARGET = tst_simplecrypt
+TEMPLATE = app
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../feathernotes
+
+SOURCES += tst_simplecrypt.cpp \
+           ../../feathernotes/simplecrypt.cpp \
+           ../../feathernotes/decryptchain.cpp
+
+HEADERS += ../../feathernotes/simplecrypt.h \
+           ../../feathernotes/decryptchain.h
@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "simplecrypt.h"
+#include "decryptchain.h"
+#include <QtTest>
+#include <QElapsedTimer>
+
+using namespace FeatherNotes;
+
+typedef char (*DecryptKernel) (char *data, int size, char lastChar, const char *key, int phase);
+
+static const quint64 testKey = Q_UINT64_C (0x0123456789abcdef);
+
+class TestSimpleCrypt : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void kernels_data();
+    void kernels();
+    void chainedBlocks_data();
+    void chainedBlocks();
+    void base64_data();
+    void base64();
+    void malformedBase64_data();
+    void malformedBase64();
+    void benchmarkKernel_data();
+    void benchmarkKernel();
+    void benchmarkBase64_data();
+    void benchmarkBase64();
+};
+
+/* the same pseudo-random bytes in every run */
+static QByteArray randomBytes (int size, quint32 seed)
+{
+    QByteArray ba (size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        ba[i] = char (seed >> 24);
+    }
+    return ba;
+}
+
+static QVector<char> keyParts()
+{
+    QVector<char> key (8);
+    for (int i = 0; i < 8; ++i)
+        key[i] = char (testKey >> (8 * i));
+    return key;
+}
+
+/* returns null if the kernel isn't compiled or the CPU doesn't support it */
+static DecryptKernel kernel (const QString &name)
+{
+    if (name == "scalar")
+        return decryptChainScalar;
+#ifdef SIMPLECRYPT_SSE2
+    if (name == "sse2")
+        return decryptChainSse2;
+#endif
+#ifdef SIMPLECRYPT_AVX2
+    if (name == "avx2" && cpuHasAvx2())
+        return decryptChainAvx2;
+#endif
+    return nullptr;
+}
+
+static QByteArray encrypted (const QByteArray &plain, SimpleCrypt::IntegrityProtectionMode mode)
+{
+    SimpleCrypt crypt (testKey);
+    crypt.setCompressionMode (SimpleCrypt::CompressionNever);
+    crypt.setIntegrityProtectionMode (mode);
+    return crypt.encryptToByteArray (plain);
+}
+
+void TestSimpleCrypt::kernels_data()
+{
+    QTest::addColumn<QString>("name");
+    QTest::newRow ("sse2") << "sse2";
+    QTest::newRow ("avx2") << "avx2";
+}
+
+/* every key phase, sizes around 16 and 32-byte blocks and unaligned data */
+void TestSimpleCrypt::kernels()
+{
+    QFETCH (QString, name);
+    DecryptKernel decrypt = kernel (name);
+    if (!decrypt)
+        QSKIP ("The kernel isn't available on this CPU.");
+
+    const QVector<char> key = keyParts();
+    const QList<int> sizes = {0, 1, 2, 7, 8, 15, 16, 17, 31, 32, 33, 47, 48, 49,
+                              63, 64, 65, 95, 96, 97, 127, 128, 129, 1000};
+    const QList<char> lastChars = {0, 0x5a, char (0xff)};
+    quint32 seed = 1;
+    for (int phase = 0; phase < 8; ++phase)
+    {
+        for (int size : sizes)
+        {
+            for (char lastChar : lastChars)
+            {
+                for (int offset = 0; offset < 2; ++offset)
+                {
+                    const QByteArray data = randomBytes (size + offset, seed++);
+                    QByteArray expected = data;
+                    QByteArray actual = data;
+                    const char expectedLast = decryptChainScalar (expected.data() + offset, size,
+                                                                  lastChar, key.constData(), phase);
+                    const char actualLast = decrypt (actual.data() + offset, size,
+                                                     lastChar, key.constData(), phase);
+                    QCOMPARE (actual, expected);
+                    QCOMPARE (actualLast, expectedLast);
+                }
+            }
+        }
+    }
+}
+
+void TestSimpleCrypt::chainedBlocks_data()
+{
+    kernels_data();
+}
+
+/* decrypting in pieces should give the same result as decrypting at once,
+   as with the blocks of decryptBase64ToByteArray() */
+void TestSimpleCrypt::chainedBlocks()
+{
+    QFETCH (QString, name);
+    DecryptKernel decrypt = kernel (name);
+    if (!decrypt)
+        QSKIP ("The kernel isn't available on this CPU.");
+
+    const QVector<char> key = keyParts();
+    const QByteArray data = randomBytes (1000, 7);
+    QByteArray expected = data;
+    decryptChainScalar (expected.data(), expected.size(), 0, key.constData(), 0);
+
+    const QList<int> pieces = {1, 15, 16, 17, 31, 32, 33, 3, 64, 5};
+    QByteArray actual = data;
+    int pos = 0, i = 0;
+    char lastChar = 0;
+    while (pos < actual.size())
+    {
+        const int n = qMin (pieces.at (i++ % pieces.size()), actual.size() - pos);
+        lastChar = decrypt (actual.data() + pos, n, lastChar, key.constData(), pos);
+        pos += n;
+    }
+    QCOMPARE (actual, expected);
+}
+
+void TestSimpleCrypt::base64_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("mode");
+
+    /* the cyphertext has 3 more bytes without protection, 5 with checksum and 23 with hash */
+    for (int size = 0; size <= 70; ++size)
+    {
+        QTest::newRow (qPrintable (QString ("none %1").arg (size))) << size << int (SimpleCrypt::ProtectionNone);
+        QTest::newRow (qPrintable (QString ("checksum %1").arg (size))) << size << int (SimpleCrypt::ProtectionChecksum);
+        QTest::newRow (qPrintable (QString ("hash %1").arg (size))) << size << int (SimpleCrypt::ProtectionHash);
+    }
+    /* around the end of the first block of 65536 base64 characters (49152 bytes) */
+    for (int size = 49146; size <= 49152; ++size)
+        QTest::newRow (qPrintable (QString ("block end %1").arg (size))) << size << int (SimpleCrypt::ProtectionNone);
+    QTest::newRow ("large") << 300000 << int (SimpleCrypt::ProtectionChecksum);
+}
+
+void TestSimpleCrypt::base64()
+{
+    QFETCH (int, size);
+    QFETCH (int, mode);
+
+    const QByteArray plain = randomBytes (size, quint32 (size));
+    const QByteArray b64 = encrypted (plain, SimpleCrypt::IntegrityProtectionMode (mode)).toBase64();
+
+    SimpleCrypt crypt (testKey);
+    QCOMPARE (crypt.decryptBase64ToByteArray (b64), plain);
+    QCOMPARE (crypt.lastError(), SimpleCrypt::ErrorNoError);
+    QCOMPARE (crypt.decryptToByteArray (QByteArray::fromBase64 (b64)), plain);
+}
+
+void TestSimpleCrypt::malformedBase64_data()
+{
+    QTest::addColumn<QByteArray>("b64");
+    QTest::addColumn<bool>("valid"); // whether the plaintext can still be recovered
+
+    const QByteArray plain = randomBytes (100000, 3);
+    const QByteArray b64 = encrypted (plain, SimpleCrypt::ProtectionHash).toBase64();
+
+    QByteArray lines;
+    for (int i = 0; i < b64.size(); i += 76)
+        lines += b64.mid (i, 76) + '\n';
+    QTest::newRow ("line breaks") << lines << true;
+    QTest::newRow ("one space") << QByteArray (b64).insert (10, ' ') << true;
+    QTest::newRow ("four spaces") << QByteArray (b64).insert (10, "    ") << true;
+    QTest::newRow ("four spaces in the second block") << QByteArray (b64).insert (70000, " \r\n\t") << true;
+    QTest::newRow ("trailing line break") << b64 + "\r\n\r\n" << true;
+    QTest::newRow ("misplaced padding") << QByteArray (b64).replace (40, 1, "=") << false;
+    QTest::newRow ("padding in the second block") << QByteArray (b64).replace (70001, 2, "==") << false;
+    QTest::newRow ("junk quartet") << QByteArray (b64).replace (100, 4, "*#~!") << false;
+    QTest::newRow ("missing quartet") << b64.left (b64.size() - 4) << false;
+    QTest::newRow ("only padding") << QByteArray ("====") << false;
+    QTest::newRow ("empty") << QByteArray() << false;
+}
+
+/* malformed data is handled as by QByteArray::fromBase64() */
+void TestSimpleCrypt::malformedBase64()
+{
+    QFETCH (QByteArray, b64);
+    QFETCH (bool, valid);
+
+    SimpleCrypt crypt (testKey);
+    const QByteArray fused = crypt.decryptBase64ToByteArray (b64);
+    QCOMPARE (fused, crypt.decryptToByteArray (QByteArray::fromBase64 (b64)));
+    if (valid)
+        QCOMPARE (fused, randomBytes (100000, 3));
+    else
+        QVERIFY (fused.isEmpty());
+}
+
+void TestSimpleCrypt::benchmarkKernel_data()
+{
+    QTest::addColumn<QString>("name");
+    QTest::newRow ("scalar") << "scalar";
+    QTest::newRow ("sse2") << "sse2";
+    QTest::newRow ("avx2") << "avx2";
+}
+
+void TestSimpleCrypt::benchmarkKernel()
+{
+    QFETCH (QString, name);
+    DecryptKernel decrypt = kernel (name);
+    if (!decrypt)
+        QSKIP ("The kernel isn't available on this CPU.");
+
+    const QVector<char> key = keyParts();
+    QByteArray data = randomBytes (16 * 1024 * 1024, 5);
+    qint64 bytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        decrypt (data.data(), data.size(), 0, key.constData(), 0);
+        bytes += data.size();
+    }
+    qInfo ("%s: %.2f GB/s", qPrintable (name), double (bytes) / qMax (timer.nsecsElapsed(), qint64 (1)));
+}
+
+void TestSimpleCrypt::benchmarkBase64_data()
+{
+    QTest::addColumn<bool>("fused");
+    QTest::newRow ("fused") << true;
+    QTest::newRow ("decode first") << false;
+}
+
+void TestSimpleCrypt::benchmarkBase64()
+{
+    QFETCH (bool, fused);
+
+    const QByteArray b64 = encrypted (randomBytes (16 * 1024 * 1024, 9),
+                                      SimpleCrypt::ProtectionNone).toBase64();
+    SimpleCrypt crypt (testKey);
+    qint64 bytes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        if (fused)
+            crypt.decryptBase64ToByteArray (b64);
+        else
+            crypt.decryptToByteArray (QByteArray::fromBase64 (b64));
+        bytes += b64.size();
+    }
+    qInfo ("%s: %.2f GB/s of base64", fused ? "fused" : "decode first",
+           double (bytes) / qMax (timer.nsecsElapsed(), qint64 (1)));
+}
+
+QTEST_APPLESS_MAIN (TestSimpleCrypt)
+
+#include "tst_simplecrypt.moc"
@@ -0,0 +1,13 @@
+QT += core gui testlib
+
+TARGET = tst_streammatch
+TEMPLATE = app
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../feathernotes
+
+SOURCES += tst_streammatch.cpp \
+           ../../feathernotes/streammatch.cpp
+
+HEADERS += ../../feathernotes/streammatch.h
@@ -0,0 +1,436 @@
+/*
+ * Copyright (C) agent 2026 <agent@local>
+ *
+ * FeatherNotes is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FeatherNotes is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "streammatch.h"
+#include <QtTest>
+#include <QTextBlock>
+
+using namespace FeatherNotes;
+
+Q_DECLARE_METATYPE (QTextDocument::FindFlags)
+
+/***************************************************************
+ ***** The per-line search that was used before the stream *****
+ ***** search, as the reference for the multi-line results. *****
+ ***************************************************************/
+static bool findBackwardInBlock (const QTextBlock &block, const QString &str, int offset,
+                                 QTextCursor &cursor, QTextDocument::FindFlags flags)
+{
+    Qt::CaseSensitivity cs = !(flags & QTextDocument::FindCaseSensitively)
+                             ? Qt::CaseInsensitive : Qt::CaseSensitive;
+
+    QString text = block.text();
+    text.replace (QChar::Nbsp, QLatin1Char (' '));
+
+    if (offset > 0 && offset == text.length())
+        -- offset;
+
+    int idx = -1;
+    while (offset >= 0 && offset <= text.length())
+    {
+        idx = text.lastIndexOf (str, offset, cs);
+        if (idx == -1)
+            return false;
+        if (flags & QTextDocument::FindWholeWords)
+        {
+            const int start = idx;
+            const int end = start + str.length();
+            if ((start != 0 && text.at (start - 1).isLetterOrNumber())
+                || (end != text.length() && text.at (end).isLetterOrNumber()))
+            {
+                offset = idx - 1;
+                idx = -1;
+                continue;
+            }
+        }
+        cursor.setPosition (block.position() + idx);
+        cursor.setPosition (cursor.position() + str.length(), QTextCursor::KeepAnchor);
+        return true;
+    }
+    return false;
+}
+
+static bool findBackward (const QTextDocument *txtdoc, const QString &str,
+                          QTextCursor &cursor, QTextDocument::FindFlags flags)
+{
+    if (!str.isEmpty() && !cursor.isNull())
+    {
+        int pos = cursor.anchor() - str.size();
+        if (pos >= 0)
+        {
+            QTextBlock block = txtdoc->findBlock (pos);
+            int blockOffset = pos - block.position();
+            while (block.isValid())
+            {
+                if (findBackwardInBlock (block, str, blockOffset, cursor, flags))
+                    return true;
+                block = block.previous();
+                blockOffset = block.length() - 1;
+            }
+        }
+    }
+    cursor = QTextCursor();
+    return false;
+}
+
+static QTextCursor perLineFinding (QTextDocument *txtdoc, const QString &str,
+                                   const QTextCursor &start, QTextDocument::FindFlags flags)
+{
+    QTextCursor res = QTextCursor (start);
+    QTextCursor cursor = start;
+    QTextCursor found;
+    QStringList sl = str.split ("\n");
+    int i = 0;
+    Qt::CaseSensitivity cs = !(flags & QTextDocument::FindCaseSensitively)
+                             ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    QString subStr;
+    if (!(flags & QTextDocument::FindBackward))
+    {
+        while (i < sl.count())
+        {
+            if (i == 0) // the first string
+            {
+                subStr = sl.at (0);
+                if (subStr.isEmpty())
+                {
+                    cursor.movePosition (QTextCursor::EndOfBlock);
+                    res.setPosition (cursor.position());
+                    if (!cursor.movePosition (QTextCursor::NextBlock))
+                        return QTextCursor();
+                    ++i;
+                }
+                else
+                {
+                    if ((found = txtdoc->find (subStr, cursor, flags)).isNull())
+                        return QTextCursor();
+                    cursor.setPosition (found.position());
+                    while (!cursor.atBlockEnd())
+                    {
+                        cursor.movePosition (QTextCursor::EndOfBlock);
+                        cursor.setPosition (cursor.position() - subStr.length());
+                        if ((found = txtdoc->find (subStr, cursor, flags)).isNull())
+                            return QTextCursor();
+                        cursor.setPosition (found.position());
+                    }
+
+                    res.setPosition (found.anchor());
+                    if (!cursor.movePosition (QTextCursor::NextBlock))
+                        return QTextCursor();
+                    ++i;
+                }
+            }
+            else if (i != sl.count() - 1) // middle strings
+            {
+                if (QString::compare (cursor.block().text(), sl.at (i), cs) != 0)
+                {
+                    cursor.setPosition (res.position());
+                    if (!cursor.movePosition (QTextCursor::NextBlock))
+                        return QTextCursor();
+                    i = 0;
+                    continue;
+                }
+
+                if (!cursor.movePosition (QTextCursor::NextBlock))
+                    return QTextCursor();
+                ++i;
+            }
+            else // the last string
+            {
+                subStr = sl.at (i);
+                if (subStr.isEmpty()) break;
+                if (!(flags & QTextDocument::FindWholeWords))
+                {
+                    if (!cursor.block().text().startsWith (subStr, cs))
+                    {
+                        cursor.setPosition (res.position());
+                        if (!cursor.movePosition (QTextCursor::NextBlock))
+                            return QTextCursor();
+                        i = 0;
+                        continue;
+                    }
+                    cursor.setPosition (cursor.anchor() + subStr.count());
+                    break;
+                }
+                else
+                {
+                    if ((found = txtdoc->find (subStr, cursor, flags)).isNull()
+                        || found.anchor() != cursor.position())
+                    {
+                        cursor.setPosition (res.position());
+                        if (!cursor.movePosition (QTextCursor::NextBlock))
+                            return QTextCursor();
+                        i = 0;
+                        continue;
+                    }
+                    cursor.setPosition (found.position());
+                    break;
+                }
+            }
+        }
+        res.setPosition (cursor.position(), QTextCursor::KeepAnchor);
+    }
+    else // backward search
+    {
+        cursor.setPosition (cursor.anchor());
+        int endPos = cursor.position();
+        while (i < sl.count())
+        {
+            if (i == 0) // the last string
+            {
+                subStr = sl.at (sl.count() - 1);
+                if (subStr.isEmpty())
+                {
+                    cursor.movePosition (QTextCursor::StartOfBlock);
+                    endPos = cursor.position();
+                    if (!cursor.movePosition (QTextCursor::PreviousBlock))
+                        return QTextCursor();
+                    cursor.movePosition (QTextCursor::EndOfBlock);
+                    ++i;
+                }
+                else
+                {
+                    if (!findBackward (txtdoc, subStr, cursor, flags))
+                        return QTextCursor();
+                    while (cursor.anchor() > cursor.block().position())
+                    {
+                        cursor.setPosition (cursor.block().position() + subStr.count());
+                        if (!findBackward (txtdoc, subStr, cursor, flags))
+                            return QTextCursor();
+                    }
+
+                    endPos = cursor.position();
+                    if (!cursor.movePosition (QTextCursor::PreviousBlock))
+                        return QTextCursor();
+                    cursor.movePosition (QTextCursor::EndOfBlock);
+                    ++i;
+                }
+            }
+            else if (i != sl.count() - 1) // the middle strings
+            {
+                if (QString::compare (cursor.block().text(), sl.at (sl.count() - i - 1), cs) != 0)
+                {
+                    cursor.setPosition (endPos);
+                    if (!cursor.movePosition (QTextCursor::PreviousBlock))
+                        return QTextCursor();
+                    cursor.movePosition (QTextCursor::EndOfBlock);
+                    i = 0;
+                    continue;
+                }
+
+                if (!cursor.movePosition (QTextCursor::PreviousBlock))
+                    return QTextCursor();
+                cursor.movePosition (QTextCursor::EndOfBlock);
+                ++i;
+            }
+            else // the first string
+            {
+                subStr = sl.at (0);
+                if (subStr.isEmpty()) break;
+                if (!(flags & QTextDocument::FindWholeWords))
+                {
+                    if (!cursor.block().text().endsWith (subStr, cs))
+                    {
+                        cursor.setPosition (endPos);
+                        if (!cursor.movePosition (QTextCursor::PreviousBlock))
+                            return QTextCursor();
+                        cursor.movePosition (QTextCursor::EndOfBlock);
+                        i = 0;
+                        continue;
+                    }
+                    cursor.setPosition (cursor.anchor() - subStr.count());
+                    break;
+                }
+                else
+                {
+                    found = cursor;
+                    if (!findBackward (txtdoc, subStr, found, flags)
+                        || found.position() != cursor.position())
+                    {
+                        cursor.setPosition (endPos);
+                        if (!cursor.movePosition (QTextCursor::PreviousBlock))
+                            return QTextCursor();
+                        cursor.movePosition (QTextCursor::EndOfBlock);
+                        i = 0;
+                        continue;
+                    }
+                    cursor.setPosition (found.anchor());
+                    break;
+                }
+            }
+        }
+        res.setPosition (cursor.anchor());
+        res.setPosition (endPos, QTextCursor::KeepAnchor);
+    }
+    return res;
+}
+/*************************/
+class TestStreamMatch : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sameAsPerLineSearch_data();
+    void sameAsPerLineSearch();
+    void caseSensitivity();
+    void overlappingPrefixes();
+    void wholeWords();
+    void emptyLinesAtEnds();
+    void nbsp();
+};
+
+/* "(anchor,position)" or "null", for readable failures */
+static QString range (const QTextCursor &cursor)
+{
+    if (cursor.isNull())
+        return QStringLiteral ("null");
+    return QString ("(%1,%2)").arg (cursor.anchor()).arg (cursor.position());
+}
+
+static QString forward (QTextDocument *doc, const QString &str, int from,
+                        QTextDocument::FindFlags flags = QTextDocument::FindCaseSensitively)
+{
+    return range (findForwardInStream (doc, str, from, flags));
+}
+
+static QString backward (QTextDocument *doc, const QString &str, int to,
+                         QTextDocument::FindFlags flags = QTextDocument::FindCaseSensitively)
+{
+    return range (findBackwardInStream (doc, str, to, flags));
+}
+
+void TestStreamMatch::sameAsPerLineSearch_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("str");
+    QTest::addColumn<QTextDocument::FindFlags>("flags");
+
+    const QTextDocument::FindFlags cs = QTextDocument::FindCaseSensitively;
+    const QTextDocument::FindFlags ww = QTextDocument::FindCaseSensitively
+                                        | QTextDocument::FindWholeWords;
+
+    QTest::newRow ("two lines") << "alpha beta\ngamma delta\nbeta\ngamma" << "beta\ngamma" << cs;
+    QTest::newRow ("case-insensitive") << "Alpha Beta\nGAMMA delta\nbeta\ngamma" << "beta\ngamma"
+                                       << QTextDocument::FindFlags();
+    QTest::newRow ("case-sensitive") << "Alpha Beta\nGAMMA delta\nbeta\ngamma" << "beta\ngamma" << cs;
+    QTest::newRow ("middle lines") << "a\na\na\nb" << "a\na\nb" << cs;
+    QTest::newRow ("empty lines") << "one\n\ntwo\n\n\nthree\n" << "\n\n" << cs;
+    QTest::newRow ("leading empty line") << "one\ntwo\n\nthree" << "\ntwo" << cs;
+    QTest::newRow ("trailing empty line") << "one\ntwo\n\nthree" << "two\n" << cs;
+    QTest::newRow ("only a line break") << "one\ntwo\n\nthree" << "\n" << cs;
+    QTest::newRow ("leading empty lines") << "x\n\n\ny\n\n" << "\n\ny" << QTextDocument::FindFlags();
+    QTest::newRow ("overlapping lines") << "ab\nab\nab\nc\nab" << "ab\nab\nc" << cs;
+    QTest::newRow ("overlapping prefix") << "aaab\nx\naab\nx" << "aab\nx" << cs;
+    QTest::newRow ("whole words") << "foo bar\nbaz foobar\nbazz\nfoo\nbaz qux" << "foo\nbaz" << ww;
+    QTest::newRow ("whole words at ends") << "xfoo\nbar\na foo\nbar b\nfoo\nbarn\nfoo\nbar" << "foo\nbar" << ww;
+    QTest::newRow ("whole words, leading line break") << "word\nnext\n\nword\nnext" << "\nnext" << ww;
+    QTest::newRow ("whole words, trailing line break") << "word\nnext\n\nword\nnext" << "word\n" << ww;
+}
+
+/* the results should be the same as those of the
+   per-line search from every position of the text */
+void TestStreamMatch::sameAsPerLineSearch()
+{
+    QFETCH (QString, text);
+    QFETCH (QString, str);
+    QFETCH (QTextDocument::FindFlags, flags);
+
+    QTextDocument doc;
+    doc.setPlainText (text);
+    for (int pos = 0; pos < doc.characterCount(); ++pos)
+    {
+        QTextCursor start (&doc);
+        start.setPosition (pos);
+        QCOMPARE (forward (&doc, str, pos, flags),
+                  range (perLineFinding (&doc, str, start, flags)));
+        QCOMPARE (backward (&doc, str, pos, flags),
+                  range (perLineFinding (&doc, str, start, flags | QTextDocument::FindBackward)));
+    }
+}
+
+void TestStreamMatch::caseSensitivity()
+{
+    QTextDocument doc;
+    doc.setPlainText ("Alpha Beta\nGAMMA delta\nbeta\ngamma");
+    QCOMPARE (forward (&doc, "beta\ngamma", 0, QTextDocument::FindFlags()), QString ("(6,16)"));
+    QCOMPARE (forward (&doc, "beta\ngamma", 0), QString ("(23,33)"));
+    QCOMPARE (backward (&doc, "beta\ngamma", 33), QString ("(23,33)"));
+    QCOMPARE (backward (&doc, "beta\ngamma", 32), QString ("null"));
+    QCOMPARE (backward (&doc, "beta\ngamma", 32, QTextDocument::FindFlags()), QString ("(6,16)"));
+}
+
+/* a mismatch after a partial match should fall back
+   to the longest prefix that can still be matched */
+void TestStreamMatch::overlappingPrefixes()
+{
+    QTextDocument doc;
+    doc.setPlainText ("ab\nab\nab\nc\nab");
+    QCOMPARE (forward (&doc, "ab\nab\nc", 0), QString ("(3,10)"));
+    QCOMPARE (backward (&doc, "ab\nab\nc", doc.characterCount() - 1), QString ("(3,10)"));
+
+    doc.setPlainText ("aaab\nx\naab\nx");
+    QCOMPARE (forward (&doc, "aab\nx", 0), QString ("(1,6)"));
+    QCOMPARE (forward (&doc, "aab\nx", 2), QString ("(7,12)"));
+    QCOMPARE (backward (&doc, "aab\nx", doc.characterCount() - 1), QString ("(7,12)"));
+    QCOMPARE (backward (&doc, "aab\nx", 11), QString ("(1,6)"));
+}
+
+void TestStreamMatch::wholeWords()
+{
+    const QTextDocument::FindFlags ww = QTextDocument::FindCaseSensitively
+                                        | QTextDocument::FindWholeWords;
+    QTextDocument doc;
+    doc.setPlainText ("xfoo\nbar\na foo\nbar b\nfoo\nbarn\nfoo\nbar");
+    QCOMPARE (forward (&doc, "foo\nbar", 0, ww), QString ("(11,18)"));
+    QCOMPARE (forward (&doc, "foo\nbar", 12, ww), QString ("(30,37)"));
+    QCOMPARE (backward (&doc, "foo\nbar", doc.characterCount() - 1, ww), QString ("(30,37)"));
+    QCOMPARE (forward (&doc, "foo\nbar", 0), QString ("(1,8)"));
+}
+
+/* an empty first or last line is a word boundary by itself */
+void TestStreamMatch::emptyLinesAtEnds()
+{
+    const QTextDocument::FindFlags ww = QTextDocument::FindCaseSensitively
+                                        | QTextDocument::FindWholeWords;
+    QTextDocument doc;
+    doc.setPlainText ("word\nnext\n\nword\nnext");
+    QCOMPARE (forward (&doc, "\nnext", 0, ww), QString ("(4,9)"));
+    QCOMPARE (backward (&doc, "\nnext", doc.characterCount() - 1, ww), QString ("(15,20)"));
+    QCOMPARE (forward (&doc, "word\n", 0, ww), QString ("(0,5)"));
+    QCOMPARE (backward (&doc, "word\n", doc.characterCount() - 1, ww), QString ("(11,16)"));
+
+    doc.setPlainText ("one\n\ntwo\n\n\nthree\n");
+    QCOMPARE (forward (&doc, "\n\n", 0), QString ("(3,5)"));
+    QCOMPARE (backward (&doc, "\n\n", doc.characterCount() - 1), QString ("(9,11)"));
+    QCOMPARE (forward (&doc, "three\n", 0), QString ("(11,17)"));
+    QCOMPARE (forward (&doc, "\n\n\n", 0), QString ("(8,11)"));
+    QCOMPARE (forward (&doc, "\n\n\n\n", 0), QString ("null"));
+}
+
+/* non-breaking spaces match spaces on every line,
+   not only on the first one as with the per-line search */
+void TestStreamMatch::nbsp()
+{
+    QTextDocument doc;
+    doc.setPlainText (QString ("a%1b\nc%1d\ne%1f").arg (QChar (QChar::Nbsp)));
+    QCOMPARE (forward (&doc, "b\nc d\ne f", 0), QString ("(2,11)"));
+    QCOMPARE (backward (&doc, "b\nc d\ne f", doc.characterCount() - 1), QString ("(2,11)"));
+    QCOMPARE (forward (&doc, QString ("b\nc%1d").arg (QChar (QChar::Nbsp)), 0), QString ("(2,7)"));
+}
+
+QTEST_MAIN (TestStreamMatch)
+
+#include "tst_streammatch.moc"